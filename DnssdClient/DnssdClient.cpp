@@ -20,9 +20,19 @@ DnssdClient::DnssdClient()
 {
     mDnssdInitFunc = nullptr;
     mDnssdCreateServiceWatcherFunc = nullptr;
+    mDnssdCreateServiceWatcherWithContextFunc = nullptr;
     mDnssdFreeServiceWatcherFunc = nullptr;
+    mDnssdGetServiceWatcherStatsFunc = nullptr;
+    mDnssdGetServiceWatcherEventHandleFunc = nullptr;
+    mDnssdPollServiceWatcherFunc = nullptr;
+    mDnssdPickInstanceFunc = nullptr;
     mDnssdCreateServiceFunc = nullptr;
+    mDnssdCreateNamedServiceFunc = nullptr;
     mDnssdFreeServiceFunc = nullptr;
+    mDnssdUpdateServiceFunc = nullptr;
+    mDnssdCreateReflectorFunc = nullptr;
+    mDnssdGetReflectorStatsFunc = nullptr;
+    mDnssdFreeReflectorFunc = nullptr;
     mDnssdServicePtr = nullptr;
     mDnssdServiceWatcherPtr = nullptr;
     mDllHandle = NULL;
@@ -71,12 +81,42 @@ DnssdErrorType DnssdClient::InitializeDnssd()
     //Get pointer to the DnssdCreateServiceWatcherFunc function using GetProcAddress:  
     mDnssdCreateServiceWatcherFunc = reinterpret_cast<DnssdCreateServiceWatcherFunc>(::GetProcAddress(mDllHandle, "dnssd_create_service_watcher"));
 
+    //Get pointer to the DnssdCreateServiceWatcherWithContextFunc function using GetProcAddress:  
+    mDnssdCreateServiceWatcherWithContextFunc = reinterpret_cast<DnssdCreateServiceWatcherWithContextFunc>(::GetProcAddress(mDllHandle, "dnssd_create_service_watcher_with_context"));
+
+    //Get pointer to the DnssdGetServiceWatcherStatsFunc function using GetProcAddress:  
+    mDnssdGetServiceWatcherStatsFunc = reinterpret_cast<DnssdGetServiceWatcherStatsFunc>(::GetProcAddress(mDllHandle, "dnssd_get_service_watcher_stats"));
+
+    //Get pointer to the DnssdGetServiceWatcherEventHandleFunc function using GetProcAddress:  
+    mDnssdGetServiceWatcherEventHandleFunc = reinterpret_cast<DnssdGetServiceWatcherEventHandleFunc>(::GetProcAddress(mDllHandle, "dnssd_get_service_watcher_event_handle"));
+
+    //Get pointer to the DnssdPollServiceWatcherFunc function using GetProcAddress:  
+    mDnssdPollServiceWatcherFunc = reinterpret_cast<DnssdPollServiceWatcherFunc>(::GetProcAddress(mDllHandle, "dnssd_poll_service_watcher"));
+
+    //Get pointer to the DnssdPickInstanceFunc function using GetProcAddress:  
+    mDnssdPickInstanceFunc = reinterpret_cast<DnssdPickInstanceFunc>(::GetProcAddress(mDllHandle, "dnssd_pick_instance"));
+
     //Get pointer to the DnssdFreeServiceFunc function using GetProcAddress:  
     mDnssdFreeServiceFunc = reinterpret_cast<DnssdFreeServiceFunc>(::GetProcAddress(mDllHandle, "dnssd_free_service"));
 
     //Get pointer to the DnssdCreateServiceFunc function using GetProcAddress:  
     mDnssdCreateServiceFunc = reinterpret_cast<DnssdCreateServiceFunc>(::GetProcAddress(mDllHandle, "dnssd_create_service"));
 
+    //Get pointer to the DnssdCreateNamedServiceFunc function using GetProcAddress:  
+    mDnssdCreateNamedServiceFunc = reinterpret_cast<DnssdCreateNamedServiceFunc>(::GetProcAddress(mDllHandle, "dnssd_create_named_service"));
+
+    //Get pointer to the DnssdUpdateServiceFunc function using GetProcAddress:  
+    mDnssdUpdateServiceFunc = reinterpret_cast<DnssdUpdateServiceFunc>(::GetProcAddress(mDllHandle, "dnssd_update_service"));
+
+    //Get pointer to the DnssdCreateReflectorFunc function using GetProcAddress:  
+    mDnssdCreateReflectorFunc = reinterpret_cast<DnssdCreateReflectorFunc>(::GetProcAddress(mDllHandle, "dnssd_create_reflector"));
+
+    //Get pointer to the DnssdGetReflectorStatsFunc function using GetProcAddress:  
+    mDnssdGetReflectorStatsFunc = reinterpret_cast<DnssdGetReflectorStatsFunc>(::GetProcAddress(mDllHandle, "dnssd_get_reflector_stats"));
+
+    //Get pointer to the DnssdFreeReflectorFunc function using GetProcAddress:  
+    mDnssdFreeReflectorFunc = reinterpret_cast<DnssdFreeReflectorFunc>(::GetProcAddress(mDllHandle, "dnssd_free_reflector"));
+
     // initialize dnssd interface
     result = mDnssdInitFunc();
     if (result != DNSSD_NO_ERROR)
@@ -95,6 +135,18 @@ DnssdErrorType DnssdClient::InitializeDnssdServiceWatcher(const std::string& ser
     return result;
 }
 
+DnssdErrorType DnssdClient::InitializeDnssdServiceWatcher(const std::string& serviceName, const std::string& port, DnssdServiceChangedContextCallback callback, void* context)
+{
+    if (mDnssdCreateServiceWatcherWithContextFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // create a dns service watcher that passes context to the callback
+    DnssdErrorType result = mDnssdCreateServiceWatcherWithContextFunc(serviceName.c_str(), callback, context, nullptr, &mDnssdServiceWatcherPtr);
+    return result;
+}
+
 DnssdErrorType DnssdClient::InitializeDnssdService(const std::string& serviceName, const std::string& port)
 {
     // create a dns service 
@@ -102,5 +154,140 @@ DnssdErrorType DnssdClient::InitializeDnssdService(const std::string& serviceNam
     return result;
 }
 
+DnssdErrorType DnssdClient::CreateDnssdService(const std::string& instanceName, const std::string& serviceName, const std::string& port, DnssdServicePtr* service)
+{
+    if (mDnssdCreateNamedServiceFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // create a named dns service. The caller owns the returned service
+    DnssdErrorType result = mDnssdCreateNamedServiceFunc(instanceName.c_str(), serviceName.c_str(), port.c_str(), service);
+    return result;
+}
+
+void DnssdClient::FreeDnssdService(DnssdServicePtr service)
+{
+    if (mDnssdFreeServiceFunc && service)
+    {
+        mDnssdFreeServiceFunc(service);
+    }
+}
+
+DnssdErrorType DnssdClient::UpdateDnssdService(DnssdServicePtr service, const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port)
+{
+    if (mDnssdUpdateServiceFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // replace the TXT attributes and optionally the port of a running service
+    DnssdErrorType result = mDnssdUpdateServiceFunc(service, attributes, attributeCount, port);
+    return result;
+}
+
+DnssdErrorType DnssdClient::CreateDnssdServiceWatcher(const std::string& serviceName, DnssdServiceChangedCallback callback, DnssdServiceWatcherPtr* serviceWatcher)
+{
+    if (mDnssdCreateServiceWatcherFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // create a dns service watcher. The caller owns the returned watcher
+    DnssdErrorType result = mDnssdCreateServiceWatcherFunc(serviceName.c_str(), callback, serviceWatcher);
+    return result;
+}
 
+DnssdErrorType DnssdClient::CreateDnssdServiceWatcher(const std::string& serviceName, DnssdServiceChangedContextCallback callback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr* serviceWatcher)
+{
+    if (mDnssdCreateServiceWatcherWithContextFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // create a dns service watcher with options and a callback context. The caller owns the returned watcher
+    DnssdErrorType result = mDnssdCreateServiceWatcherWithContextFunc(serviceName.c_str(), callback, context, options, serviceWatcher);
+    return result;
+}
 
+void DnssdClient::FreeDnssdServiceWatcher(DnssdServiceWatcherPtr serviceWatcher)
+{
+    if (mDnssdFreeServiceWatcherFunc && serviceWatcher)
+    {
+        mDnssdFreeServiceWatcherFunc(serviceWatcher);
+    }
+}
+
+DnssdErrorType DnssdClient::GetDnssdServiceWatcherStats(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherStats* stats)
+{
+    if (mDnssdGetServiceWatcherStatsFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    return mDnssdGetServiceWatcherStatsFunc(serviceWatcher, stats);
+}
+
+DnssdErrorType DnssdClient::GetDnssdServiceWatcherEventHandle(DnssdServiceWatcherPtr serviceWatcher, HANDLE* eventHandle)
+{
+    if (mDnssdGetServiceWatcherEventHandleFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    return mDnssdGetServiceWatcherEventHandleFunc(serviceWatcher, eventHandle);
+}
+
+DnssdErrorType DnssdClient::PollDnssdServiceWatcher(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherEvent* events, unsigned int maxEvents, unsigned int* count)
+{
+    if (mDnssdPollServiceWatcherFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // events is built with the same dnssd.h as this wrapper
+    return mDnssdPollServiceWatcherFunc(serviceWatcher, events, sizeof(DnssdServiceWatcherEvent), maxEvents, count);
+}
+
+DnssdErrorType DnssdClient::PickDnssdInstance(DnssdServiceWatcherPtr serviceWatcher, DnssdPickPolicy policy, DnssdServiceInfo* info)
+{
+    if (mDnssdPickInstanceFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    if (info != nullptr)
+    {
+        info->structSize = sizeof(DnssdServiceInfo);
+    }
+    return mDnssdPickInstanceFunc(serviceWatcher, policy, info);
+}
+
+DnssdErrorType DnssdClient::CreateDnssdReflector(const DnssdReflectorOptions* options, DnssdReflectorPtr* reflector)
+{
+    if (mDnssdCreateReflectorFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    // the caller owns the returned reflector
+    return mDnssdCreateReflectorFunc(options, reflector);
+}
+
+DnssdErrorType DnssdClient::GetDnssdReflectorStats(DnssdReflectorPtr reflector, DnssdReflectorStats* stats)
+{
+    if (mDnssdGetReflectorStatsFunc == nullptr)
+    {
+        return DNSSD_DLL_MISSING_ERROR;
+    }
+
+    return mDnssdGetReflectorStatsFunc(reflector, stats);
+}
+
+void DnssdClient::FreeDnssdReflector(DnssdReflectorPtr reflector)
+{
+    if (mDnssdFreeReflectorFunc && reflector)
+    {
+        mDnssdFreeReflectorFunc(reflector);
+    }
+}
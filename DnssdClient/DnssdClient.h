@@ -27,15 +27,41 @@ namespace dnssd_uwp
 
         DnssdErrorType InitializeDnssd();
         DnssdErrorType InitializeDnssdServiceWatcher(const std::string& serviceName, const std::string& port, DnssdServiceChangedCallback callback);
+        DnssdErrorType InitializeDnssdServiceWatcher(const std::string& serviceName, const std::string& port, DnssdServiceChangedContextCallback callback, void* context);
         DnssdErrorType InitializeDnssdService(const std::string& serviceName, const std::string& port);
 
+        // create and free additional services and watchers not owned by the DnssdClient
+        DnssdErrorType CreateDnssdService(const std::string& instanceName, const std::string& serviceName, const std::string& port, DnssdServicePtr* service);
+        void FreeDnssdService(DnssdServicePtr service);
+        DnssdErrorType UpdateDnssdService(DnssdServicePtr service, const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port);
+        DnssdErrorType CreateDnssdServiceWatcher(const std::string& serviceName, DnssdServiceChangedCallback callback, DnssdServiceWatcherPtr* serviceWatcher);
+        DnssdErrorType CreateDnssdServiceWatcher(const std::string& serviceName, DnssdServiceChangedContextCallback callback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr* serviceWatcher);
+        void FreeDnssdServiceWatcher(DnssdServiceWatcherPtr serviceWatcher);
+        DnssdErrorType GetDnssdServiceWatcherStats(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherStats* stats);
+        DnssdErrorType GetDnssdServiceWatcherEventHandle(DnssdServiceWatcherPtr serviceWatcher, HANDLE* eventHandle);
+        DnssdErrorType PollDnssdServiceWatcher(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherEvent* events, unsigned int maxEvents, unsigned int* count);
+        DnssdErrorType PickDnssdInstance(DnssdServiceWatcherPtr serviceWatcher, DnssdPickPolicy policy, DnssdServiceInfo* info);
+        DnssdErrorType CreateDnssdReflector(const DnssdReflectorOptions* options, DnssdReflectorPtr* reflector);
+        DnssdErrorType GetDnssdReflectorStats(DnssdReflectorPtr reflector, DnssdReflectorStats* stats);
+        void FreeDnssdReflector(DnssdReflectorPtr reflector);
+
     private:
         // Dnssd DLL function pointers
         DnssdInitializeFunc             mDnssdInitFunc;
         DnssdCreateServiceWatcherFunc   mDnssdCreateServiceWatcherFunc;
+        DnssdCreateServiceWatcherWithContextFunc mDnssdCreateServiceWatcherWithContextFunc;
         DnssdFreeServiceWatcherFunc     mDnssdFreeServiceWatcherFunc;
+        DnssdGetServiceWatcherStatsFunc mDnssdGetServiceWatcherStatsFunc;
+        DnssdGetServiceWatcherEventHandleFunc mDnssdGetServiceWatcherEventHandleFunc;
+        DnssdPollServiceWatcherFunc     mDnssdPollServiceWatcherFunc;
+        DnssdPickInstanceFunc           mDnssdPickInstanceFunc;
         DnssdCreateServiceFunc          mDnssdCreateServiceFunc;
+        DnssdCreateNamedServiceFunc     mDnssdCreateNamedServiceFunc;
         DnssdFreeServiceFunc            mDnssdFreeServiceFunc;
+        DnssdUpdateServiceFunc          mDnssdUpdateServiceFunc;
+        DnssdCreateReflectorFunc        mDnssdCreateReflectorFunc;
+        DnssdGetReflectorStatsFunc      mDnssdGetReflectorStatsFunc;
+        DnssdFreeReflectorFunc          mDnssdFreeReflectorFunc;
 
         // dnssd service
         DnssdServicePtr mDnssdServicePtr;
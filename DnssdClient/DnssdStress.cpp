@@ -0,0 +1,392 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdStress.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace dnssd_uwp;
+using namespace std;
+
+// "dnssd-stress-café-" in UTF-8. A name the library did not register as UTF-8 comes back without the prefix, so the
+// swarm never converges
+static const std::string gInstancePrefix = "dnssd-stress-caf\xC3\xA9-";
+
+static void dnssdStressCallback(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context)
+{
+    static_cast<DnssdStress*>(context)->OnDnssdServiceChanged(update, info);
+}
+
+DnssdStress::DnssdStress(DnssdClient* client, const std::string& serviceName, const DnssdStressOptions& options)
+    : mClient(client)
+    , mServiceName(serviceName)
+    , mOptions(options)
+    , mWatcher(nullptr)
+    , mEventHandle(nullptr)
+    , mNextInstance(0)
+    , mNextPort(0)
+    , mEvents(0)
+    , mRegistrationErrors(0)
+    , mRandom(GetTickCount())
+{
+    InitializeCriticalSection(&mCriticalSection);
+}
+
+DnssdStress::~DnssdStress()
+{
+    mClient->FreeDnssdServiceWatcher(mWatcher);
+    mWatcher = nullptr;
+
+    for (auto it = mResponders.begin(); it != mResponders.end(); ++it)
+    {
+        mClient->FreeDnssdService(it->second.service);
+    }
+    mResponders.clear();
+
+    DeleteCriticalSection(&mCriticalSection);
+}
+
+DnssdErrorType DnssdStress::Run()
+{
+    cout << "dnssd stress: " << mOptions.instanceCount << " responders of type " << mServiceName;
+    cout << ", churn " << mOptions.churnPerSecond << "/s for " << mOptions.churnSeconds << "s";
+    cout << ", " << (mOptions.shardCount > 1 ? mOptions.shardCount : 1) << " shard(s)" << endl << endl;
+
+    ULONGLONG phaseStart = GetTickCount64();
+    DnssdServiceWatcherOptions watcherOptions = {};
+    watcherOptions.structSize = sizeof(DnssdServiceWatcherOptions);
+    watcherOptions.executor = mOptions.executor;
+    watcherOptions.shardCount = mOptions.shardCount;
+    DnssdErrorType result = mClient->CreateDnssdServiceWatcher(mServiceName, dnssdStressCallback, this, &watcherOptions, &mWatcher);
+    if (result != DNSSD_NO_ERROR)
+    {
+        return result;
+    }
+
+    if (mOptions.executor == DNSSD_EXECUTOR_QUEUE)
+    {
+        // events are pulled from the convergence loop instead of delivered by callback
+        result = mClient->GetDnssdServiceWatcherEventHandle(mWatcher, &mEventHandle);
+        if (result != DNSSD_NO_ERROR)
+        {
+            return result;
+        }
+    }
+
+    // register the initial swarm
+    for (unsigned int i = 0; i < mOptions.instanceCount; ++i)
+    {
+        StartResponder(gInstancePrefix + to_string(mNextInstance++));
+    }
+    WaitForConvergence("initial", phaseStart);
+    ReportStartup();
+
+    // churn the swarm at a fixed rate, then wait for the watcher to catch up
+    if (mOptions.churnPerSecond > 0 && mOptions.churnSeconds > 0)
+    {
+        ULONGLONG churnStart = GetTickCount64();
+        ULONGLONG churnEnd = churnStart + mOptions.churnSeconds * 1000ULL;
+        unsigned int operations = 0;
+        while (GetTickCount64() < churnEnd)
+        {
+            ULONGLONG due = churnStart + (operations * 1000ULL) / mOptions.churnPerSecond;
+            ULONGLONG now = GetTickCount64();
+            if (due > now)
+            {
+                Sleep(static_cast<DWORD>(due - now));
+            }
+            ChurnResponder();
+            ++operations;
+        }
+        WaitForConvergence("churn", GetTickCount64());
+    }
+
+    // remove every responder at once
+    std::vector<std::string> names;
+    for (auto it = mResponders.begin(); it != mResponders.end(); ++it)
+    {
+        names.push_back(it->first);
+    }
+    for (auto it = names.begin(); it != names.end(); ++it)
+    {
+        StopResponder(*it);
+    }
+    WaitForConvergence("vanish", GetTickCount64());
+
+    cout << endl << "watcher events: " << mEvents << ", registration errors: " << mRegistrationErrors << endl;
+    ReportEvents();
+    return DNSSD_NO_ERROR;
+}
+
+void DnssdStress::OnDnssdServiceChanged(DnssdServiceUpdateType update, DnssdServiceInfoPtr info)
+{
+    if (info == nullptr || info->instanceName == nullptr)
+    {
+        return;
+    }
+
+    // only track the instances of this swarm. The watcher may report the full instance name
+    std::string name(info->instanceName);
+    name = name.substr(0, name.find('.'));
+    if (name.compare(0, gInstancePrefix.size(), gInstancePrefix) != 0)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&mCriticalSection);
+    ++mEvents;
+    if (update == ServiceRemoved)
+    {
+        mDiscovered.erase(name);
+    }
+    else
+    {
+        mDiscovered[name] = info->port;
+    }
+    LeaveCriticalSection(&mCriticalSection);
+}
+
+DnssdErrorType DnssdStress::StartResponder(const std::string& instanceName)
+{
+    Responder responder;
+    responder.port = NextPort();
+    responder.service = nullptr;
+
+    DnssdErrorType result = mClient->CreateDnssdService(instanceName, mServiceName, responder.port, &responder.service);
+    EnterCriticalSection(&mCriticalSection);
+    if (result == DNSSD_NO_ERROR)
+    {
+        mResponders[instanceName] = responder;
+    }
+    else
+    {
+        ++mRegistrationErrors;
+    }
+    LeaveCriticalSection(&mCriticalSection);
+    return result;
+}
+
+void DnssdStress::StopResponder(const std::string& instanceName)
+{
+    DnssdServicePtr service = nullptr;
+
+    EnterCriticalSection(&mCriticalSection);
+    auto it = mResponders.find(instanceName);
+    if (it != mResponders.end())
+    {
+        service = it->second.service;
+        mResponders.erase(it);
+    }
+    LeaveCriticalSection(&mCriticalSection);
+
+    mClient->FreeDnssdService(service);
+}
+
+void DnssdStress::MoveResponder(const std::string& instanceName)
+{
+    DnssdServicePtr service = nullptr;
+    std::string port = NextPort();
+
+    EnterCriticalSection(&mCriticalSection);
+    auto it = mResponders.find(instanceName);
+    if (it != mResponders.end())
+    {
+        service = it->second.service;
+    }
+    LeaveCriticalSection(&mCriticalSection);
+
+    if (service == nullptr)
+    {
+        return;
+    }
+
+    // the instance keeps its registration and is re-announced with the new port
+    DnssdErrorType result = mClient->UpdateDnssdService(service, nullptr, 0, port.c_str());
+    EnterCriticalSection(&mCriticalSection);
+    if (result == DNSSD_NO_ERROR)
+    {
+        mResponders[instanceName].port = port;
+    }
+    else
+    {
+        ++mRegistrationErrors;
+    }
+    LeaveCriticalSection(&mCriticalSection);
+}
+
+void DnssdStress::ChurnResponder()
+{
+    // keep the swarm close to its configured size: vanish, re-port or add one responder
+    unsigned int operation = mRandom() % 3;
+    if (mResponders.empty() || mResponders.size() < mOptions.instanceCount / 2)
+    {
+        operation = 2;
+    }
+
+    if (operation == 2)
+    {
+        StartResponder(gInstancePrefix + to_string(mNextInstance++));
+        return;
+    }
+
+    auto it = mResponders.begin();
+    std::advance(it, mRandom() % mResponders.size());
+    std::string name = it->first;
+    if (operation == 1)
+    {
+        // same instance, new port
+        MoveResponder(name);
+    }
+    else
+    {
+        StopResponder(name);
+    }
+}
+
+void DnssdStress::PollEvents()
+{
+    const unsigned int maxEvents = 64;
+    DnssdServiceWatcherEvent events[maxEvents];
+    unsigned int count = 0;
+
+    do
+    {
+        if (mClient->PollDnssdServiceWatcher(mWatcher, events, maxEvents, &count) != DNSSD_NO_ERROR)
+        {
+            return;
+        }
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            OnDnssdServiceChanged(events[i].update, &events[i].info);
+        }
+    } while (count == maxEvents);
+}
+
+bool DnssdStress::IsConverged(size_t& discovered)
+{
+    bool converged = true;
+    discovered = 0;
+
+    if (mEventHandle != nullptr)
+    {
+        PollEvents();
+    }
+
+    EnterCriticalSection(&mCriticalSection);
+    for (auto it = mResponders.begin(); it != mResponders.end(); ++it)
+    {
+        auto found = mDiscovered.find(it->first);
+        if (found != mDiscovered.end() && found->second == it->second.port)
+        {
+            ++discovered;
+        }
+        else
+        {
+            converged = false;
+        }
+    }
+
+    // stale instances the watcher has not removed yet
+    if (mDiscovered.size() != discovered)
+    {
+        converged = false;
+    }
+    LeaveCriticalSection(&mCriticalSection);
+
+    return converged;
+}
+
+void DnssdStress::WaitForConvergence(const char* phase, ULONGLONG phaseStart)
+{
+    ULONGLONG deadline = phaseStart + mOptions.timeoutSeconds * 1000ULL;
+    size_t discovered = 0;
+    bool converged = IsConverged(discovered);
+
+    while (!converged && GetTickCount64() < deadline)
+    {
+        if (mEventHandle != nullptr)
+        {
+            // wakes as soon as the watcher queues an event
+            WaitForSingleObject(mEventHandle, 10);
+        }
+        else
+        {
+            Sleep(10);
+        }
+        converged = IsConverged(discovered);
+    }
+
+    ULONGLONG elapsed = GetTickCount64() - phaseStart;
+    size_t registered = mResponders.size();
+    double completeness = registered > 0 ? (100.0 * discovered) / registered : (converged ? 100.0 : 0.0);
+
+    cout << left << setw(8) << phase;
+    cout << " registered: " << setw(6) << registered;
+    cout << " discovered: " << setw(6) << discovered;
+    cout << " complete: " << fixed << setprecision(1) << completeness << "%";
+    if (converged)
+    {
+        cout << " converged in " << elapsed << " ms" << endl;
+    }
+    else
+    {
+        cout << " not converged after " << elapsed << " ms" << endl;
+    }
+}
+
+void DnssdStress::ReportStartup()
+{
+    DnssdServiceWatcherStats stats;
+    if (mClient->GetDnssdServiceWatcherStats(mWatcher, &stats) != DNSSD_NO_ERROR)
+    {
+        return;
+    }
+
+    cout << "         time to first result: " << stats.firstResultMilliseconds << " ms";
+    cout << ", first enumeration pass: " << stats.enumerationMilliseconds << " ms" << endl;
+}
+
+void DnssdStress::ReportEvents()
+{
+    DnssdServiceWatcherStats stats;
+    if (mClient->GetDnssdServiceWatcherStats(mWatcher, &stats) != DNSSD_NO_ERROR)
+    {
+        return;
+    }
+
+    cout << "backend events: " << stats.backendEvents << ", filtered: " << stats.filteredEvents;
+    cout << ", merged: " << stats.mergedEvents << ", callbacks: " << stats.callbacks;
+    if (stats.callbacks > 0)
+    {
+        cout << " (" << fixed << setprecision(2) << static_cast<double>(stats.backendEvents) / stats.callbacks << " backend events per callback)";
+    }
+    cout << endl;
+    cout << "instance slots: " << stats.instanceSlots << " for " << mNextInstance << " instances created" << endl;
+    if (stats.services > 0)
+    {
+        cout << "service table: " << stats.tableBytes << " bytes for " << stats.services << " services (";
+        cout << stats.tableBytes / stats.services << " bytes per service)" << endl;
+    }
+    if (stats.removals > 0)
+    {
+        cout << "removals: " << stats.removals << ", departure to notification: " << stats.lastRemovalMilliseconds << " ms last, ";
+        cout << stats.maxRemovalMilliseconds << " ms max" << endl;
+    }
+}
+
+std::string DnssdStress::NextPort()
+{
+    unsigned int port = mOptions.basePort + (mNextPort++ % (65535 - mOptions.basePort));
+    return to_string(port);
+}
@@ -0,0 +1,87 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include "dnssd.h"
+#include "DnssdClient.h"
+#include <string>
+#include <map>
+#include <random>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+namespace dnssd_uwp
+{
+    typedef struct
+    {
+        unsigned int instanceCount;     // number of responders registered before the churn phase
+        unsigned int churnPerSecond;    // responders removed, re-ported or added per second during the churn phase
+        unsigned int churnSeconds;      // length of the churn phase. 0 skips the churn phase
+        unsigned int timeoutSeconds;    // max time to wait for the watcher to converge after each phase
+        unsigned short basePort;        // first port handed out to a responder
+        DnssdCallbackExecutor executor; // where the watcher delivers its callbacks
+        unsigned int shardCount;        // service table shards of the watcher. 0 or 1 for an unsharded table
+    } DnssdStressOptions;
+
+    // Synthetic responder swarm. Registers a set of service instances in this process,
+    // churns them and reports how completely and how quickly a service watcher created
+    // with dnssd_create_service_watcher converges on the registered set.
+    class DnssdStress
+    {
+    public:
+        DnssdStress(DnssdClient* client, const std::string& serviceName, const DnssdStressOptions& options);
+        ~DnssdStress();
+
+        DnssdErrorType Run();
+
+        // called from the dnssd service watcher callback
+        void OnDnssdServiceChanged(DnssdServiceUpdateType update, DnssdServiceInfoPtr info);
+
+    private:
+        typedef struct
+        {
+            DnssdServicePtr service;
+            std::string port;
+        } Responder;
+
+        DnssdErrorType StartResponder(const std::string& instanceName);
+        void StopResponder(const std::string& instanceName);
+        void MoveResponder(const std::string& instanceName);
+        void ChurnResponder();
+        void PollEvents();
+        bool IsConverged(size_t& discovered);
+        void WaitForConvergence(const char* phase, ULONGLONG phaseStart);
+        void ReportStartup();
+        void ReportEvents();
+        std::string NextPort();
+
+        DnssdClient* mClient;
+        std::string mServiceName;
+        DnssdStressOptions mOptions;
+        DnssdServiceWatcherPtr mWatcher;
+        HANDLE mEventHandle;            // set when the watcher is polled with DNSSD_EXECUTOR_QUEUE
+
+        // registered responders keyed by instance name
+        std::map<std::string, Responder> mResponders;
+
+        // instance name -> port as reported by the service watcher
+        std::map<std::string, std::string> mDiscovered;
+
+        unsigned int mNextInstance;
+        unsigned int mNextPort;
+        unsigned int mEvents;
+        unsigned int mRegistrationErrors;
+        std::mt19937 mRandom;
+        CRITICAL_SECTION mCriticalSection;
+    };
+};
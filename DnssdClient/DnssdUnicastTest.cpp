@@ -0,0 +1,454 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#include "DnssdUnicastTest.h"
+#include <ws2tcpip.h>
+#include <windns.h>
+#include <chrono>
+#include <iostream>
+
+// needed for the stand-in server socket
+#pragma comment(lib, "ws2_32.lib")
+
+using namespace dnssd_uwp;
+using namespace std;
+
+static const char* gTestDomain = "unicast.test";
+static const char* gTestServiceName = "_dnssdtest._tcp";
+static const unsigned int gTestTimeoutMilliseconds = 10000;
+static const unsigned int gRecordTtl = 30;
+
+// "Café Printer" in UTF-8. Non-ASCII labels must reach the client unchanged
+static const std::string gUtf8Instance = "Caf\xC3\xA9 Printer";
+static const std::string gPlainInstance = "Scanner 2";
+
+static void Append16(std::vector<unsigned char>& data, unsigned int value)
+{
+    data.push_back(static_cast<unsigned char>(value >> 8));
+    data.push_back(static_cast<unsigned char>(value));
+}
+
+static void Append32(std::vector<unsigned char>& data, unsigned int value)
+{
+    Append16(data, value >> 16);
+    Append16(data, value & 0xffff);
+}
+
+static void AppendName(std::vector<unsigned char>& data, const std::vector<std::string>& name)
+{
+    for (auto it = name.begin(); it != name.end(); ++it)
+    {
+        data.push_back(static_cast<unsigned char>(it->size()));
+        data.insert(data.end(), it->begin(), it->end());
+    }
+    data.push_back(0);
+}
+
+static std::vector<std::string> SplitName(const std::string& dotted)
+{
+    std::vector<std::string> labels;
+    size_t start = 0;
+    while (start < dotted.size())
+    {
+        size_t end = dotted.find('.', start);
+        if (end == std::string::npos)
+        {
+            end = dotted.size();
+        }
+        labels.push_back(dotted.substr(start, end - start));
+        start = end + 1;
+    }
+    return labels;
+}
+
+// labels followed by the labels of suffix
+static std::vector<std::string> Concat(const std::vector<std::string>& labels, const std::vector<std::string>& suffix)
+{
+    std::vector<std::string> name(labels);
+    name.insert(name.end(), suffix.begin(), suffix.end());
+    return name;
+}
+
+// DNS names compare case insensitively in ASCII only
+static bool SameName(const std::vector<std::string>& a, const std::vector<std::string>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].size() != b[i].size())
+        {
+            return false;
+        }
+        for (size_t j = 0; j < a[i].size(); ++j)
+        {
+            unsigned char x = a[i][j];
+            unsigned char y = b[i][j];
+            if ((x < 0x80 ? tolower(x) : x) != (y < 0x80 ? tolower(y) : y))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+DnssdUnicastTest::DnssdUnicastTest(DnssdClient* client, const std::string& serverAddress)
+    : mClient(client)
+    , mServerAddress(serverAddress)
+    , mSocket(INVALID_SOCKET)
+    , mFailures(0)
+{
+    mInstances.test = this;
+    mInstances.watcher = nullptr;
+    mFiltered.test = this;
+    mFiltered.watcher = nullptr;
+    mTypes.test = this;
+    mTypes.watcher = nullptr;
+}
+
+DnssdUnicastTest::~DnssdUnicastTest()
+{
+    mClient->FreeDnssdServiceWatcher(mInstances.watcher);
+    mClient->FreeDnssdServiceWatcher(mFiltered.watcher);
+    mClient->FreeDnssdServiceWatcher(mTypes.watcher);
+
+    // closing the socket ends the server thread's receive
+    if (mSocket != INVALID_SOCKET)
+    {
+        closesocket(mSocket);
+        WSACleanup();
+    }
+    if (mServer.joinable())
+    {
+        mServer.join();
+    }
+}
+
+DnssdErrorType DnssdUnicastTest::Run()
+{
+    cout << "dnssd unicast test: browsing " << gTestServiceName << "." << gTestDomain << " on a stand-in server at " << mServerAddress << endl << endl;
+
+    BuildZone();
+    if (!StartServer())
+    {
+        cout << "Unable to serve DNS on " << mServerAddress << ":53. Pass another loopback address, e.g. -unicast-test 127.0.0.53" << endl;
+        return DNSSD_UNSPECIFIED_ERROR;
+    }
+
+    DnssdErrorType result = StartBrowse(mInstances, gTestServiceName, nullptr);
+    if (result == DNSSD_NO_ERROR)
+    {
+        result = StartBrowse(mFiltered, gTestServiceName, "k");
+    }
+    if (result == DNSSD_NO_ERROR)
+    {
+        result = StartBrowse(mTypes, DNSSD_SERVICE_TYPE_ENUMERATION, nullptr);
+    }
+    if (result != DNSSD_NO_ERROR)
+    {
+        cout << "Unable to create unicast service watcher: " << result << endl;
+        return result;
+    }
+
+    if (!WaitForServices(gTestTimeoutMilliseconds))
+    {
+        cout << "timed out after " << gTestTimeoutMilliseconds << "ms" << endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // the UTF-8 name comes back unchanged, and the SRV record with the lowest priority wins
+    Check("UTF-8 instance", mInstances, gUtf8Instance, "127.0.0.2:8080");
+    Check("plain instance", mInstances, gPlainInstance, "127.0.0.2:631");
+    CheckCount("instances", mInstances, 2);
+
+    // only the first instance has the TXT key
+    Check("TXT key filter", mFiltered, gUtf8Instance, "127.0.0.2:8080");
+    CheckCount("filtered instances", mFiltered, 1);
+
+    // types have no host or port
+    Check("service type", mTypes, gTestServiceName, ":");
+    CheckCount("service types", mTypes, 1);
+
+    cout << endl << (mFailures == 0 ? "PASSED" : "FAILED") << endl;
+    return mFailures == 0 ? DNSSD_NO_ERROR : DNSSD_UNSPECIFIED_ERROR;
+}
+
+void DnssdUnicastTest::BuildZone()
+{
+    Name domain = SplitName(gTestDomain);
+    Name type = Concat(SplitName(gTestServiceName), domain);
+    Name host = Concat(Name(1, "host"), domain);
+    Name utf8Instance = Concat(Name(1, gUtf8Instance), type);
+    Name plainInstance = Concat(Name(1, gPlainInstance), type);
+
+    std::vector<unsigned char> data;
+
+    // the domain's SOA sets the poll interval
+    AppendName(data, host);
+    AppendName(data, Concat(Name(1, "admin"), domain));
+    Append32(data, 1);
+    Append32(data, 3600);
+    Append32(data, 600);
+    Append32(data, 86400);
+    Append32(data, 15);
+    AddRecord(domain, DNS_TYPE_SOA, data);
+
+    data.clear();
+    AppendName(data, type);
+    AddRecord(Concat(SplitName(DNSSD_SERVICE_TYPE_ENUMERATION), domain), DNS_TYPE_PTR, data);
+
+    data.clear();
+    AppendName(data, utf8Instance);
+    AddRecord(type, DNS_TYPE_PTR, data);
+
+    data.clear();
+    AppendName(data, plainInstance);
+    AddRecord(type, DNS_TYPE_PTR, data);
+
+    // two SRV records. The browser must use the one with the lowest priority
+    data.clear();
+    Append16(data, 20);
+    Append16(data, 0);
+    Append16(data, 9090);
+    AppendName(data, host);
+    AddRecord(utf8Instance, DNS_TYPE_SRV, data);
+
+    data.clear();
+    Append16(data, 10);
+    Append16(data, 5);
+    Append16(data, 8080);
+    AppendName(data, host);
+    AddRecord(utf8Instance, DNS_TYPE_SRV, data);
+
+    data.clear();
+    Append16(data, 0);
+    Append16(data, 0);
+    Append16(data, 631);
+    AppendName(data, host);
+    AddRecord(plainInstance, DNS_TYPE_SRV, data);
+
+    // TXT strings are length prefixed
+    std::string txt = "k=v";
+    data.clear();
+    data.push_back(static_cast<unsigned char>(txt.size()));
+    data.insert(data.end(), txt.begin(), txt.end());
+    AddRecord(utf8Instance, DNS_TYPE_TEXT, data);
+
+    data.clear();
+    data.push_back(127);
+    data.push_back(0);
+    data.push_back(0);
+    data.push_back(2);
+    AddRecord(host, DNS_TYPE_A, data);
+}
+
+void DnssdUnicastTest::AddRecord(const Name& owner, unsigned short type, const std::vector<unsigned char>& data)
+{
+    Record record;
+    record.owner = owner;
+    record.type = type;
+    record.data = data;
+    mZone.push_back(record);
+}
+
+bool DnssdUnicastTest::StartServer()
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        return false;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(53);
+    mSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (mSocket == INVALID_SOCKET ||
+        InetPtonA(AF_INET, mServerAddress.c_str(), &address.sin_addr) != 1 ||
+        ::bind(mSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        if (mSocket != INVALID_SOCKET)
+        {
+            closesocket(mSocket);
+            mSocket = INVALID_SOCKET;
+        }
+        WSACleanup();
+        return false;
+    }
+
+    mServer = std::thread([this]() { Serve(); });
+    return true;
+}
+
+void DnssdUnicastTest::Serve()
+{
+    unsigned char query[512];
+    unsigned char response[512];
+    for (;;)
+    {
+        sockaddr_in from;
+        int fromLength = sizeof(from);
+        int length = recvfrom(mSocket, reinterpret_cast<char*>(query), sizeof(query), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (length == SOCKET_ERROR)
+        {
+            // the socket was closed
+            return;
+        }
+
+        size_t size = Answer(query, length, response, sizeof(response));
+        if (size > 0)
+        {
+            sendto(mSocket, reinterpret_cast<char*>(response), static_cast<int>(size), 0, reinterpret_cast<sockaddr*>(&from), fromLength);
+        }
+    }
+}
+
+size_t DnssdUnicastTest::Answer(const unsigned char* query, size_t length, unsigned char* response, size_t size)
+{
+    // header, then a single question. Anything else is dropped
+    if (length < 12 || query[4] != 0 || query[5] != 1)
+    {
+        return 0;
+    }
+
+    Name name;
+    size_t offset = 12;
+    while (offset < length && query[offset] != 0)
+    {
+        size_t labelLength = query[offset];
+        if (labelLength > 63 || offset + 1 + labelLength > length)
+        {
+            return 0;
+        }
+        name.push_back(std::string(reinterpret_cast<const char*>(query) + offset + 1, labelLength));
+        offset += 1 + labelLength;
+    }
+    if (offset + 5 > length)
+    {
+        return 0;
+    }
+    offset += 1;
+    unsigned short type = static_cast<unsigned short>((query[offset] << 8) | query[offset + 1]);
+    size_t questionEnd = offset + 4;
+
+    std::vector<unsigned char> answers;
+    unsigned int answerCount = 0;
+    bool nameExists = false;
+    for (auto it = mZone.begin(); it != mZone.end(); ++it)
+    {
+        if (!SameName(it->owner, name))
+        {
+            continue;
+        }
+
+        nameExists = true;
+        if (it->type == type)
+        {
+            AppendName(answers, it->owner);
+            Append16(answers, it->type);
+            Append16(answers, 1);
+            Append32(answers, gRecordTtl);
+            Append16(answers, static_cast<unsigned int>(it->data.size()));
+            answers.insert(answers.end(), it->data.begin(), it->data.end());
+            ++answerCount;
+        }
+    }
+
+    std::vector<unsigned char> message;
+    message.push_back(query[0]);
+    message.push_back(query[1]);
+    message.push_back(0x84 | (query[2] & 0x01));                   // response, authoritative, recursion desired as asked
+    message.push_back(0x80 | (nameExists ? 0 : 3));                // recursion available, NXDOMAIN for unknown names
+    Append16(message, 1);
+    Append16(message, answerCount);
+    Append16(message, 0);
+    Append16(message, 0);
+    message.insert(message.end(), query + 12, query + questionEnd);
+    message.insert(message.end(), answers.begin(), answers.end());
+
+    if (message.size() > size)
+    {
+        return 0;
+    }
+    memcpy(response, message.data(), message.size());
+    return message.size();
+}
+
+void DnssdUnicastTest::OnDnssdServiceChanged(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context)
+{
+    Browse* browse = static_cast<Browse*>(context);
+    if (info == nullptr || info->instanceName == nullptr)
+    {
+        return;
+    }
+
+    DnssdUnicastTest* test = browse->test;
+    std::lock_guard<std::mutex> lock(test->mMutex);
+    if (update == ServiceRemoved)
+    {
+        browse->services.erase(info->instanceName);
+    }
+    else
+    {
+        browse->services[info->instanceName] = std::string(info->host ? info->host : "") + ":" + (info->port ? info->port : "");
+    }
+    test->mChanged.notify_all();
+}
+
+DnssdErrorType DnssdUnicastTest::StartBrowse(Browse& browse, const std::string& serviceName, const char* txtKeyFilter)
+{
+    DnssdServiceWatcherOptions options = {};
+    options.structSize = sizeof(DnssdServiceWatcherOptions);
+    options.domain = gTestDomain;
+    options.unicastServer = mServerAddress.c_str();
+    options.txtKeyFilter = txtKeyFilter;
+    return mClient->CreateDnssdServiceWatcher(serviceName, OnDnssdServiceChanged, &browse, &options, &browse.watcher);
+}
+
+bool DnssdUnicastTest::WaitForServices(unsigned int timeoutMilliseconds)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mChanged.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this]()
+    {
+        return mInstances.services.size() >= 2 && mFiltered.services.size() >= 1 && mTypes.services.size() >= 1;
+    });
+}
+
+void DnssdUnicastTest::Check(const char* what, const Browse& browse, const std::string& name, const std::string& expected)
+{
+    auto it = browse.services.find(name);
+    std::string reported = it != browse.services.end() ? it->second : "(not reported)";
+    bool passed = reported == expected;
+    if (!passed)
+    {
+        ++mFailures;
+    }
+
+    // the names may not be printable on the console code page
+    cout << (passed ? "ok     " : "FAILED ") << what << ": expected " << expected << ", reported " << reported << endl;
+}
+
+void DnssdUnicastTest::CheckCount(const char* what, const Browse& browse, size_t expected)
+{
+    bool passed = browse.services.size() == expected;
+    if (!passed)
+    {
+        ++mFailures;
+    }
+    cout << (passed ? "ok     " : "FAILED ") << what << ": expected " << expected << ", reported " << browse.services.size() << endl;
+}
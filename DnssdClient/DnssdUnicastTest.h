@@ -0,0 +1,86 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#pragma once
+
+#include "dnssd.h"
+#include "DnssdClient.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <winsock2.h>
+
+namespace dnssd_uwp
+{
+    // Wide-area browsing test. Serves a small fixed zone from a stand-in DNS server on a
+    // loopback address, browses it with unicast service watchers and checks that the
+    // instances are parsed and resolved the way the zone describes them.
+    class DnssdUnicastTest
+    {
+    public:
+        // serverAddress is the IPv4 address the stand-in server listens on, port 53
+        DnssdUnicastTest(DnssdClient* client, const std::string& serverAddress);
+        ~DnssdUnicastTest();
+
+        // returns DNSSD_NO_ERROR if every check passed
+        DnssdErrorType Run();
+
+    private:
+        // domain name as its labels, each one raw UTF-8
+        typedef std::vector<std::string> Name;
+
+        typedef struct
+        {
+            Name owner;
+            unsigned short type;
+            std::vector<unsigned char> data;
+        } Record;
+
+        // one service watcher of the test and the services it reports as instance name -> "host:port"
+        typedef struct
+        {
+            DnssdUnicastTest* test;
+            DnssdServiceWatcherPtr watcher;
+            std::map<std::string, std::string> services;
+        } Browse;
+
+        static void OnDnssdServiceChanged(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context);
+
+        void BuildZone();
+        void AddRecord(const Name& owner, unsigned short type, const std::vector<unsigned char>& data);
+        bool StartServer();
+        void Serve();
+        size_t Answer(const unsigned char* query, size_t length, unsigned char* response, size_t size);
+        DnssdErrorType StartBrowse(Browse& browse, const std::string& serviceName, const char* txtKeyFilter);
+        bool WaitForServices(unsigned int timeoutMilliseconds);
+        void Check(const char* what, const Browse& browse, const std::string& name, const std::string& expected);
+        void CheckCount(const char* what, const Browse& browse, size_t expected);
+
+        DnssdClient* mClient;
+        std::string mServerAddress;
+        SOCKET mSocket;
+        std::thread mServer;
+        std::vector<Record> mZone;
+
+        Browse mInstances;          // every instance of the test type
+        Browse mFiltered;           // instances with the TXT key of the zone
+        Browse mTypes;              // the service types of the domain
+
+        std::mutex mMutex;
+        std::condition_variable mChanged;
+        unsigned int mFailures;
+    };
+};
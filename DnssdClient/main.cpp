@@ -13,12 +13,16 @@
 #include "stdafx.h"
 #include "dnssd.h"
 #include "DnssdClient.h"
+#include "DnssdStress.h"
+#include "DnssdUnicastTest.h"
 #include "WindowsVersionHelper.h"
 #include <iostream>
 #include <string>
 #include <conio.h>
 #include <assert.h>
 #include <memory>
+#include <cstdlib>
+#include <vector>
 
 #define USING_APP_MANIFEST
 #define WIN32_LEAN_AND_MEAN
@@ -27,30 +31,28 @@
 using namespace std;
 using namespace dnssd_uwp;
 
-CRITICAL_SECTION gCriticalSection;
-
 static const std::string gServiceName = "_daap._tcp";
 static const std::string gServicePort = "3689";
 
 std::unique_ptr<DnssdClient> gDnssdClient;
 
-void dnssdServiceChangedCallback(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info)
+// context is the service type being watched. Callbacks for one watcher are delivered one at a time so no lock is needed
+void dnssdServiceChangedCallback(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context)
 {
-    EnterCriticalSection(&gCriticalSection);
-    string portName = "In";
+    const std::string* serviceName = static_cast<const std::string*>(context);
 
     switch (update)
     {
     case ServiceAdded:
-        cout << "*** dnssd service added ***" << endl;
+        cout << "*** " << *serviceName << " service added ***" << endl;
         break;
 
     case ServiceUpdated:
-        cout << "*** dnssd service updated ***" << endl;
+        cout << "*** " << *serviceName << " service updated ***" << endl;
         break;
 
     case ServiceRemoved:
-        cout << "*** dnssd service removed ***" << endl;
+        cout << "*** " << *serviceName << " service removed ***" << endl;
         break;
     }
 
@@ -62,10 +64,29 @@ void dnssdServiceChangedCallback(const DnssdServiceWatcherPtr serviceWatcher, Dn
         wprintf(L"host: %S\n", info->host);
         wprintf(L"port: %S\n", info->port);
         wprintf(L"  id: %S\n", info->id);
+        if (info->flags & DNSSD_SERVICE_FLAG_PROVISIONAL)
+        {
+            wprintf(L"(provisional: restored from the warm-start cache)\n");
+        }
+        if (info->flags & DNSSD_SERVICE_FLAG_UNHEALTHY)
+        {
+            wprintf(L"(unhealthy: liveness probes failed)\n");
+        }
+        if (info->changedFields & DNSSD_FIELD_INSTANCE_NAME)
+        {
+            wprintf(L"(name changed%S%S)\n", info->previousInstanceName ? " from " : "", info->previousInstanceName ? info->previousInstanceName : "");
+        }
+        if (info->changedFields & DNSSD_FIELD_HOST)
+        {
+            wprintf(L"(host changed%S%S)\n", info->previousHost ? " from " : "", info->previousHost ? info->previousHost : "");
+        }
+        if (info->changedFields & DNSSD_FIELD_PORT)
+        {
+            wprintf(L"(port changed%S%S)\n", info->previousPort ? " from " : "", info->previousPort ? info->previousPort : "");
+        }
         SetConsoleOutputCP(cp);
     }
     cout << endl;
-    LeaveCriticalSection(&gCriticalSection);
 }
 
 BOOL CtrlHandler(DWORD fdwCtrlType)
@@ -88,9 +109,79 @@ BOOL CtrlHandler(DWORD fdwCtrlType)
     }
 }
 
-int main()
+// DnssdClient.exe -stress <instances> [churn per second] [churn seconds] [timeout seconds] [inline|thread|pool|queue] [shards]
+static bool parseStressOptions(int argc, char* argv[], DnssdStressOptions& options)
+{
+    if (argc < 3 || string(argv[1]) != "-stress")
+    {
+        return false;
+    }
+
+    options.instanceCount = atoi(argv[2]);
+    options.churnPerSecond = argc > 3 ? atoi(argv[3]) : 0;
+    options.churnSeconds = argc > 4 ? atoi(argv[4]) : 0;
+    options.timeoutSeconds = argc > 5 ? atoi(argv[5]) : 60;
+    options.basePort = 49152;
+
+    string executor = argc > 6 ? argv[6] : "inline";
+    options.executor = executor == "queue" ? DNSSD_EXECUTOR_QUEUE : executor == "pool" ? DNSSD_EXECUTOR_POOL :
+        executor == "thread" ? DNSSD_EXECUTOR_THREAD : DNSSD_EXECUTOR_INLINE;
+    options.shardCount = argc > 7 ? atoi(argv[7]) : 0;
+    return true;
+}
+
+// DnssdClient.exe -reflect <target address> <source subnet> [service types...]
+static void runReflector(int argc, char* argv[])
+{
+    std::vector<const char*> serviceTypes;
+    for (int i = 4; i < argc; ++i)
+    {
+        serviceTypes.push_back(argv[i]);
+    }
+    if (serviceTypes.empty())
+    {
+        serviceTypes.push_back(gServiceName.c_str());
+    }
+
+    DnssdReflectorOptions options = {};
+    options.serviceTypes = serviceTypes.data();
+    options.serviceTypeCount = static_cast<unsigned int>(serviceTypes.size());
+    options.targetAddress = argv[2];
+    options.sourceSubnet = argv[3];
+
+    DnssdReflectorPtr reflector = nullptr;
+    DnssdErrorType result = gDnssdClient->CreateDnssdReflector(&options, &reflector);
+    if (result != DNSSD_NO_ERROR)
+    {
+        cout << "Unable to create dnssd reflector: " << result << endl;
+        return;
+    }
+
+    // report the reflector counters until user presses a key on keyboard
+    while (!_kbhit())
+    {
+        DnssdReflectorStats stats;
+        if (gDnssdClient->GetDnssdReflectorStats(reflector, &stats) == DNSSD_NO_ERROR)
+        {
+            cout << "proxies: " << stats.proxies << " forwarded: " << stats.forwardedChanges << " suppressed: " << stats.suppressedChanges
+                << " failed: " << stats.failedChanges << endl;
+        }
+        Sleep(5000);
+    }
+    _getch();
+
+    gDnssdClient->FreeDnssdReflector(reflector);
+}
+
+int main(int argc, char* argv[])
 {
     DnssdErrorType result = DNSSD_NO_ERROR;
+    DnssdStressOptions stressOptions;
+    bool stress = parseStressOptions(argc, argv, stressOptions);
+
+    // DnssdClient.exe -types lists the service types on the network instead of the _daap._tcp instances
+    bool types = argc > 1 && string(argv[1]) == "-types";
+    const std::string serviceName = types ? DNSSD_SERVICE_TYPE_ENUMERATION : gServiceName;
 
     gDnssdClient = std::unique_ptr<DnssdClient>(new DnssdClient());
 
@@ -117,9 +208,36 @@ int main()
         goto cleanup;
     }
   
-    InitializeCriticalSection(&gCriticalSection);
+    if (stress)
+    {
+        // run the synthetic responder swarm instead of the interactive sample
+        {
+            DnssdStress dnssdStress(gDnssdClient.get(), gServiceName, stressOptions);
+            result = dnssdStress.Run();
+        }
+        gDnssdClient.reset();
+        return result == DNSSD_NO_ERROR ? 0 : 1;
+    }
+
+    // DnssdClient.exe -unicast-test [server address] browses a fixed zone served on the address, 127.0.0.1 by default
+    if (argc > 1 && string(argv[1]) == "-unicast-test")
+    {
+        {
+            DnssdUnicastTest unicastTest(gDnssdClient.get(), argc > 2 ? argv[2] : "127.0.0.1");
+            result = unicastTest.Run();
+        }
+        gDnssdClient.reset();
+        return result == DNSSD_NO_ERROR ? 0 : 1;
+    }
+
+    if (argc > 3 && string(argv[1]) == "-reflect")
+    {
+        runReflector(argc, argv);
+        gDnssdClient.reset();
+        return 0;
+    }
 
-    result = gDnssdClient->InitializeDnssdServiceWatcher(gServiceName, gServicePort, dnssdServiceChangedCallback);
+    result = gDnssdClient->InitializeDnssdServiceWatcher(serviceName, gServicePort, dnssdServiceChangedCallback, (void*)&serviceName);
     if (result != DNSSD_NO_ERROR)
     {
         cout << "Unable to initialize dnssd service watcher" << endl;
@@ -127,7 +245,7 @@ int main()
     }
 
 #if 1
-    result = gDnssdClient->InitializeDnssdService(gServiceName, gServicePort);
+    result = types ? DNSSD_NO_ERROR : gDnssdClient->InitializeDnssdService(gServiceName, gServicePort);
     if (result != DNSSD_NO_ERROR)
     {
         cout << "Unable to initialize dnssd service" << endl;
@@ -142,7 +260,6 @@ cleanup:
 
     gDnssdClient.reset();
     gDnssdClient = nullptr;
-    DeleteCriticalSection(&gCriticalSection);
 
     return 0;
 }
\ No newline at end of file
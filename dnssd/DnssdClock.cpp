@@ -0,0 +1,98 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdClock.h"
+#include "DnssdScheduler.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace dnssd_uwp
+{
+    static unsigned long long SystemFileTime()
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        return (static_cast<unsigned long long>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    }
+
+    class DnssdSteadyClock : public DnssdClock
+    {
+    public:
+        virtual TimePoint Now()
+        {
+            return std::chrono::steady_clock::now();
+        }
+
+        virtual unsigned long long SystemTime()
+        {
+            return SystemFileTime();
+        }
+    };
+
+    static DnssdSteadyClock sSteadyClock;
+    static std::atomic<DnssdClock*> sClock(&sSteadyClock);
+
+    DnssdClock& DnssdClock::Current()
+    {
+        return *sClock.load();
+    }
+
+    void DnssdClock::Install(DnssdClock* clock)
+    {
+        sClock.store(clock != nullptr ? clock : &sSteadyClock);
+    }
+
+    DnssdManualClock::DnssdManualClock()
+        : mStart(std::chrono::steady_clock::now())
+        , mStartSystemTime(SystemFileTime())
+        , mElapsed(0)
+    {
+    }
+
+    DnssdClock::TimePoint DnssdManualClock::Now()
+    {
+        return mStart + std::chrono::steady_clock::duration(mElapsed.load());
+    }
+
+    unsigned long long DnssdManualClock::SystemTime()
+    {
+        // FILETIME is in 100ns units
+        auto elapsed = std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10000000>>>(Now() - mStart);
+        return mStartSystemTime + elapsed.count();
+    }
+
+    void DnssdManualClock::Set(TimePoint time)
+    {
+        mElapsed.store((time - mStart).count());
+    }
+
+    void DnssdManualClock::Advance(unsigned int milliseconds)
+    {
+        DnssdScheduler& scheduler = DnssdScheduler::Instance();
+        TimePoint target = Now() + std::chrono::milliseconds(milliseconds);
+
+        // step from deadline to deadline so a task that schedules itself again runs once per period
+        TimePoint next;
+        while (scheduler.NextDeadline(next) && next <= target)
+        {
+            if (next > Now())
+            {
+                Set(next);
+            }
+            scheduler.RunDue();
+        }
+
+        Set(target);
+        scheduler.RunDue();
+    }
+}
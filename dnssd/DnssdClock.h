@@ -0,0 +1,69 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace dnssd_uwp
+{
+    // Time source of every timer and timestamp in the library.
+    // The steady clock is used unless a manual clock is installed from inside the library.
+    // The manual clock is not exported: unicast polls and probes still run on the thread pool
+    // against real sockets, so it cannot make a watcher deterministic.
+    class DnssdClock
+    {
+    public:
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        virtual ~DnssdClock() {}
+
+        virtual TimePoint Now() = 0;
+
+        // current UTC time as a FILETIME. Used for times saved across runs
+        virtual unsigned long long SystemTime() = 0;
+
+        // a manual clock does not move by itself. The scheduler then never arms a thread pool timer
+        virtual bool IsManual() const { return false; }
+
+        static DnssdClock& Current();
+
+        // install clock for the whole process. nullptr restores the steady clock.
+        // Must be done before any watcher or service is created
+        static void Install(DnssdClock* clock);
+    };
+
+    // clock that only moves when it is advanced
+    class DnssdManualClock : public DnssdClock
+    {
+    public:
+        DnssdManualClock();
+
+        virtual TimePoint Now();
+        virtual unsigned long long SystemTime();
+        virtual bool IsManual() const { return true; }
+
+        // move the clock forward. Scheduler tasks that become due run on the calling thread
+        // in deadline order, each with the clock set to its deadline
+        void Advance(unsigned int milliseconds);
+
+    private:
+        void Set(TimePoint time);
+
+        TimePoint mStart;
+        unsigned long long mStartSystemTime;
+
+        // time since mStart in steady clock ticks
+        std::atomic<long long> mElapsed;
+    };
+};
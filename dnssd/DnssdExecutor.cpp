@@ -0,0 +1,345 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdExecutor.h"
+#include "DnssdUtils.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+using namespace Windows::Foundation;
+using namespace Windows::System::Threading;
+
+namespace dnssd_uwp
+{
+    struct DnssdExecutorState
+    {
+        DnssdExecutorState(DnssdExecutor::Handler handler)
+            : handler(handler)
+            , stopped(false)
+            , draining(false)
+            , running(0)
+        {
+        }
+
+        DnssdExecutor::Handler handler;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopped;
+        bool draining;                              // DNSSD_EXECUTOR_INLINE. A thread is delivering the queue
+        unsigned int running;                       // handlers in progress
+
+        std::deque<DnssdServiceEvent> queue;        // DNSSD_EXECUTOR_INLINE, DNSSD_EXECUTOR_THREAD and DNSSD_EXECUTOR_QUEUE
+
+        // DNSSD_EXECUTOR_POOL. One queue per service id. A strand is drained by at
+        // most one pool thread at a time and its front stays queued while delivered
+        std::unordered_map<std::string, std::deque<DnssdServiceEvent>> strands;
+    };
+
+    // executor whose handler is running on this thread
+    static thread_local DnssdExecutorState* tDelivering = nullptr;
+
+    // called and returns with the state locked
+    static void Deliver(DnssdExecutorState& state, std::unique_lock<std::mutex>& lock, const DnssdServiceEvent& event)
+    {
+        ++state.running;
+        lock.unlock();
+
+        // a handler may flush another watcher's inline executor on this thread
+        DnssdExecutorState* outer = tDelivering;
+        tDelivering = &state;
+        state.handler(event);
+        tDelivering = outer;
+
+        lock.lock();
+        --state.running;
+        state.condition.notify_all();
+    }
+
+    DnssdExecutor::DnssdExecutor(Handler handler)
+        : mState(std::make_shared<DnssdExecutorState>(handler))
+    {
+    }
+
+    DnssdExecutor::~DnssdExecutor()
+    {
+        Shutdown();
+    }
+
+    void DnssdExecutor::Shutdown()
+    {
+        std::unique_lock<std::mutex> lock(mState->mutex);
+        mState->stopped = true;
+        mState->queue.clear();
+        mState->strands.clear();
+        mState->condition.notify_all();
+
+        // a handler that shuts down its own executor cannot wait for itself
+        unsigned int self = tDelivering == mState.get() ? 1 : 0;
+        mState->condition.wait(lock, [this, self] { return mState->running <= self; });
+    }
+
+    // delivers on the thread that posted the events, once it has released its locks. A thread
+    // that finds another one delivering leaves its events to it, so callbacks stay in order and one at a time
+    class DnssdInlineExecutor : public DnssdExecutor
+    {
+    public:
+        DnssdInlineExecutor(Handler handler)
+            : DnssdExecutor(handler)
+        {
+        }
+
+        virtual void Post(DnssdServiceEvent&& event)
+        {
+            std::lock_guard<std::mutex> lock(mState->mutex);
+            if (!mState->stopped)
+            {
+                mState->queue.push_back(std::move(event));
+            }
+        }
+
+        virtual void Flush()
+        {
+            // the state outlives the executor if the handler frees the watcher
+            auto state = mState;
+            std::unique_lock<std::mutex> lock(state->mutex);
+            if (state->draining)
+            {
+                return;
+            }
+
+            state->draining = true;
+            while (!state->stopped && !state->queue.empty())
+            {
+                DnssdServiceEvent event = std::move(state->queue.front());
+                state->queue.pop_front();
+                Deliver(*state, lock, event);
+            }
+            state->draining = false;
+        }
+    };
+
+    // delivers every event in order on one thread owned by the executor
+    class DnssdThreadExecutor : public DnssdExecutor
+    {
+    public:
+        DnssdThreadExecutor(Handler handler)
+            : DnssdExecutor(handler)
+        {
+            // the thread keeps the state alive and exits once the executor is shut down
+            auto state = mState;
+            std::thread([state]() { Run(*state); }).detach();
+        }
+
+        virtual void Post(DnssdServiceEvent&& event)
+        {
+            std::lock_guard<std::mutex> lock(mState->mutex);
+            if (!mState->stopped)
+            {
+                mState->queue.push_back(std::move(event));
+                mState->condition.notify_all();
+            }
+        }
+
+    private:
+        static void Run(DnssdExecutorState& state)
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            for (;;)
+            {
+                state.condition.wait(lock, [&state] { return state.stopped || !state.queue.empty(); });
+                if (state.stopped)
+                {
+                    return;
+                }
+
+                DnssdServiceEvent event = std::move(state.queue.front());
+                state.queue.pop_front();
+                Deliver(state, lock, event);
+            }
+        }
+    };
+
+    // delivers on the thread pool. Events for one service id are delivered in order,
+    // events for different services may be delivered in parallel
+    class DnssdPoolExecutor : public DnssdExecutor
+    {
+    public:
+        DnssdPoolExecutor(Handler handler)
+            : DnssdExecutor(handler)
+        {
+        }
+
+        virtual void Post(DnssdServiceEvent&& event)
+        {
+            std::string serviceId = event.id;
+            bool idle = false;
+            {
+                std::lock_guard<std::mutex> lock(mState->mutex);
+                if (mState->stopped)
+                {
+                    return;
+                }
+
+                auto& strand = mState->strands[serviceId];
+                idle = strand.empty();
+                strand.push_back(std::move(event));
+            }
+
+            // a strand that is already queued will deliver this event after the ones before it
+            if (idle)
+            {
+                auto state = mState;
+                ThreadPool::RunAsync(ref new WorkItemHandler([state, serviceId](IAsyncAction^ action)
+                {
+                    DrainStrand(*state, serviceId);
+                }));
+            }
+        }
+
+    private:
+        static void DrainStrand(DnssdExecutorState& state, const std::string& serviceId)
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            while (!state.stopped)
+            {
+                auto it = state.strands.find(serviceId);
+                if (it == state.strands.end())
+                {
+                    break;
+                }
+
+                DnssdServiceEvent event = std::move(it->second.front());
+                Deliver(state, lock, event);
+
+                // the strand is gone if the executor was shut down during delivery
+                it = state.strands.find(serviceId);
+                if (it == state.strands.end())
+                {
+                    break;
+                }
+
+                it->second.pop_front();
+                if (it->second.empty())
+                {
+                    state.strands.erase(it);
+                    break;
+                }
+            }
+        }
+    };
+
+    // queues events for the client to poll from its own loop. An event handle
+    // signals pending events so the client can wait on it with its other handles
+    class DnssdQueueExecutor : public DnssdExecutor
+    {
+    public:
+        DnssdQueueExecutor(Handler handler)
+            : DnssdExecutor(handler)
+        {
+            mEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        }
+
+        virtual ~DnssdQueueExecutor()
+        {
+            if (mEvent != nullptr)
+            {
+                CloseHandle(mEvent);
+            }
+        }
+
+        virtual void Post(DnssdServiceEvent&& event)
+        {
+            std::lock_guard<std::mutex> lock(mState->mutex);
+            if (mState->stopped)
+            {
+                return;
+            }
+
+            // only the first pending event needs to wake the client
+            if (mState->queue.empty())
+            {
+                SetEvent(mEvent);
+            }
+            mState->queue.push_back(std::move(event));
+        }
+
+        virtual void* GetEventHandle()
+        {
+            return mEvent;
+        }
+
+        virtual DnssdErrorType Poll(DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int& count)
+        {
+            // the events returned by the previous poll are released here. Only the client calls Poll
+            mPolled.clear();
+            {
+                std::lock_guard<std::mutex> lock(mState->mutex);
+                while (mPolled.size() < maxEvents && !mState->queue.empty())
+                {
+                    mPolled.push_back(std::move(mState->queue.front()));
+                    mState->queue.pop_front();
+                }
+
+                if (mState->queue.empty())
+                {
+                    ResetEvent(mEvent);
+                }
+            }
+
+            count = static_cast<unsigned int>(mPolled.size());
+            // eventSize is the stride of the caller's array. Its events may be shorter or longer than this library's
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                const DnssdServiceEvent& event = mPolled[i];
+                DnssdServiceWatcherEvent* target = reinterpret_cast<DnssdServiceWatcherEvent*>(reinterpret_cast<char*>(events) + static_cast<size_t>(i) * eventSize);
+                DnssdServiceInfo info;
+                DnssdServiceEventToInfo(event, info);
+                target->update = event.type;
+                CopyDnssdServiceInfo(info, &target->info, eventSize - offsetof(DnssdServiceWatcherEvent, info));
+            }
+
+            return DNSSD_NO_ERROR;
+        }
+
+    private:
+        HANDLE mEvent;
+
+        // events returned by the last poll. clear() keeps the capacity for the next batch
+        std::vector<DnssdServiceEvent> mPolled;
+    };
+
+    std::unique_ptr<DnssdExecutor> DnssdExecutor::Create(DnssdCallbackExecutor type, Handler handler)
+    {
+        switch (type)
+        {
+        case DNSSD_EXECUTOR_THREAD:
+            return std::unique_ptr<DnssdExecutor>(new DnssdThreadExecutor(handler));
+
+        case DNSSD_EXECUTOR_POOL:
+            return std::unique_ptr<DnssdExecutor>(new DnssdPoolExecutor(handler));
+
+        case DNSSD_EXECUTOR_QUEUE:
+            return std::unique_ptr<DnssdExecutor>(new DnssdQueueExecutor(handler));
+
+        default:
+            return std::unique_ptr<DnssdExecutor>(new DnssdInlineExecutor(handler));
+        }
+    }
+}
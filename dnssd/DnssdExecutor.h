@@ -0,0 +1,95 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "dnssd.h"
+
+namespace dnssd_uwp
+{
+    // a service watcher event queued for delivery on another thread. Owns copies of the strings
+    struct DnssdServiceEvent
+    {
+        DnssdServiceUpdateType type;
+        unsigned int flags;
+        unsigned int changedFields;
+        unsigned int previousFields;                // fields with a previous value
+        std::string id;
+        std::string instanceName;
+        std::string host;
+        std::string port;
+        std::string previousInstanceName;
+        std::string previousHost;
+        std::string previousPort;
+    };
+
+    // point info at the strings of a queued event
+    inline void DnssdServiceEventToInfo(const DnssdServiceEvent& event, DnssdServiceInfo& info)
+    {
+        info.id = event.id.c_str();
+        info.instanceName = event.instanceName.c_str();
+        info.host = event.host.c_str();
+        info.port = event.port.c_str();
+        info.structSize = sizeof(DnssdServiceInfo);
+        info.flags = event.flags;
+        info.changedFields = event.changedFields;
+        info.previousInstanceName = (event.previousFields & DNSSD_FIELD_INSTANCE_NAME) ? event.previousInstanceName.c_str() : nullptr;
+        info.previousHost = (event.previousFields & DNSSD_FIELD_HOST) ? event.previousHost.c_str() : nullptr;
+        info.previousPort = (event.previousFields & DNSSD_FIELD_PORT) ? event.previousPort.c_str() : nullptr;
+    }
+
+    struct DnssdExecutorState;
+
+    // Delivers a watcher's events off the DeviceWatcher thread.
+    // The queue and handler live in state shared with the delivery threads, so an
+    // executor can be destroyed from inside its own handler.
+    class DnssdExecutor
+    {
+    public:
+        typedef std::function<void(const DnssdServiceEvent& event)> Handler;
+
+        virtual ~DnssdExecutor();
+
+        // queue an event. Never waits for the handler
+        virtual void Post(DnssdServiceEvent&& event) = 0;
+
+        // DNSSD_EXECUTOR_QUEUE only. Event signaled while events are queued
+        virtual void* GetEventHandle() { return nullptr; }
+
+        // DNSSD_EXECUTOR_QUEUE only. Strings of the returned events stay valid until the next Poll
+        virtual DnssdErrorType Poll(DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int& count)
+        {
+            count = 0;
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        // DNSSD_EXECUTOR_INLINE only. Deliver the queued events on the calling thread.
+        // Called by the thread that posted them once it holds no lock. The executor may be destroyed by the handler
+        virtual void Flush() {}
+
+        // drop queued events and wait for a handler in progress on another thread to return.
+        // Must not be called while holding a lock the handler takes
+        void Shutdown();
+
+        // handler is not used by DNSSD_EXECUTOR_QUEUE
+        static std::unique_ptr<DnssdExecutor> Create(DnssdCallbackExecutor type, Handler handler);
+
+    protected:
+        DnssdExecutor(Handler handler);
+
+        std::shared_ptr<DnssdExecutorState> mState;
+    };
+};
@@ -0,0 +1,225 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdInstancePicker.h"
+
+namespace dnssd_uwp
+{
+    DnssdInstancePicker::DnssdInstancePicker()
+        : mRandom(std::random_device()())
+    {
+    }
+
+    void DnssdInstancePicker::Update(const std::wstring& id, unsigned short priority, unsigned short weight)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(id);
+        if (it != mEntries.end())
+        {
+            Entry& entry = it->second;
+            if (entry.priority == priority && entry.weight == weight)
+            {
+                return;
+            }
+
+            // only the groups the instance leaves and joins are rebuilt
+            auto group = mGroups.find(entry.priority);
+            group->second.members.erase(id);
+            group->second.dirty = true;
+            if (group->second.members.empty())
+            {
+                mGroups.erase(group);
+            }
+
+            entry.priority = priority;
+            entry.weight = weight;
+        }
+        else
+        {
+            Entry entry;
+            entry.priority = priority;
+            entry.weight = weight;
+            entry.recent = mRecent.insert(mRecent.begin(), id);
+            mEntries[id] = entry;
+        }
+
+        Group& group = mGroups[priority];
+        group.members.insert(id);
+        group.dirty = true;
+    }
+
+    void DnssdInstancePicker::Remove(const std::wstring& id)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(id);
+        if (it == mEntries.end())
+        {
+            return;
+        }
+
+        auto group = mGroups.find(it->second.priority);
+        group->second.members.erase(id);
+        group->second.dirty = true;
+        if (group->second.members.empty())
+        {
+            mGroups.erase(group);
+        }
+
+        mRecent.erase(it->second.recent);
+        mEntries.erase(it);
+    }
+
+    bool DnssdInstancePicker::Pick(DnssdPickPolicy policy, std::wstring& id)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mEntries.empty())
+        {
+            return false;
+        }
+
+        bool picked = false;
+        switch (policy)
+        {
+        case DNSSD_PICK_ROUND_ROBIN:
+            picked = PickRoundRobin(id);
+            break;
+
+        case DNSSD_PICK_LEAST_RECENTLY_PICKED:
+            picked = PickLeastRecent(id);
+            break;
+
+        default:
+            picked = PickWeighted(id);
+            break;
+        }
+
+        if (picked)
+        {
+            // every pick counts for the least recently picked order
+            auto recent = mEntries[id].recent;
+            mRecent.splice(mRecent.end(), mRecent, recent);
+        }
+        return picked;
+    }
+
+    bool DnssdInstancePicker::PickWeighted(std::wstring& id)
+    {
+        // RFC 2782: the lowest priority wins, then a choice weighted by the SRV weights
+        Group& group = mGroups.begin()->second;
+        if (group.dirty)
+        {
+            BuildAliasTable(group);
+        }
+
+        std::uniform_int_distribution<unsigned int> column(0, static_cast<unsigned int>(group.ids.size() - 1));
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        unsigned int i = column(mRandom);
+        id = *group.ids[coin(mRandom) < group.probability[i] ? i : group.alias[i]];
+        return true;
+    }
+
+    bool DnssdInstancePicker::PickRoundRobin(std::wstring& id)
+    {
+        // ids are kept sorted, so the instance after the last one picked is the next in turn
+        auto it = mEntries.upper_bound(mCursor);
+        if (it == mEntries.end())
+        {
+            it = mEntries.begin();
+        }
+
+        mCursor = it->first;
+        id = it->first;
+        return true;
+    }
+
+    bool DnssdInstancePicker::PickLeastRecent(std::wstring& id)
+    {
+        id = mRecent.front();
+        return true;
+    }
+
+    void DnssdInstancePicker::BuildAliasTable(Group& group)
+    {
+        group.ids.clear();
+        group.probability.clear();
+        group.alias.clear();
+
+        // weight 0 instances are only picked when the whole group has weight 0
+        std::vector<double> weights;
+        double total = 0.0;
+        for (auto it = group.members.begin(); it != group.members.end(); ++it)
+        {
+            unsigned short weight = mEntries[*it].weight;
+            if (weight > 0)
+            {
+                group.ids.push_back(&*it);
+                weights.push_back(weight);
+                total += weight;
+            }
+        }
+
+        if (group.ids.empty())
+        {
+            for (auto it = group.members.begin(); it != group.members.end(); ++it)
+            {
+                group.ids.push_back(&*it);
+                weights.push_back(1.0);
+                total += 1.0;
+            }
+        }
+
+        // Vose's alias method: scale the weights to an average of 1 and pair each column
+        // below 1 with a column above 1 that fills the rest of it
+        size_t count = group.ids.size();
+        group.probability.resize(count);
+        group.alias.resize(count);
+
+        std::vector<unsigned int> under;
+        std::vector<unsigned int> over;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            weights[i] = weights[i] * count / total;
+            (weights[i] < 1.0 ? under : over).push_back(i);
+        }
+
+        while (!under.empty() && !over.empty())
+        {
+            unsigned int less = under.back();
+            unsigned int more = over.back();
+            under.pop_back();
+            over.pop_back();
+
+            group.probability[less] = weights[less];
+            group.alias[less] = more;
+
+            weights[more] = (weights[more] + weights[less]) - 1.0;
+            (weights[more] < 1.0 ? under : over).push_back(more);
+        }
+
+        // what is left is 1 up to rounding
+        for (auto it = over.begin(); it != over.end(); ++it)
+        {
+            group.probability[*it] = 1.0;
+            group.alias[*it] = *it;
+        }
+        for (auto it = under.begin(); it != under.end(); ++it)
+        {
+            group.probability[*it] = 1.0;
+            group.alias[*it] = *it;
+        }
+
+        group.dirty = false;
+    }
+}
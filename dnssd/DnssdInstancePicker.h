@@ -0,0 +1,82 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "dnssd.h"
+
+namespace dnssd_uwp
+{
+    // Chooses one of a watcher's live instances for dnssd_pick_instance().
+    // The watcher reports every change to its service table, so a pick never
+    // walks the table. Thread safe.
+    class DnssdInstancePicker
+    {
+    public:
+        DnssdInstancePicker();
+
+        // add an instance or change its SRV priority and weight
+        void Update(const std::wstring& id, unsigned short priority, unsigned short weight);
+
+        void Remove(const std::wstring& id);
+
+        // returns false if there is no instance to pick
+        bool Pick(DnssdPickPolicy policy, std::wstring& id);
+
+    private:
+        // instances of one SRV priority and the alias table over their weights
+        struct Group
+        {
+            Group() : dirty(true) {}
+
+            std::set<std::wstring> members;
+            bool dirty;                             // members or weights changed since the table was built
+            std::vector<const std::wstring*> ids;
+            std::vector<double> probability;
+            std::vector<unsigned int> alias;
+        };
+
+        struct Entry
+        {
+            unsigned short priority;
+            unsigned short weight;
+            std::list<std::wstring>::iterator recent;
+        };
+
+        bool PickWeighted(std::wstring& id);
+        bool PickRoundRobin(std::wstring& id);
+        bool PickLeastRecent(std::wstring& id);
+        void BuildAliasTable(Group& group);
+
+        std::mutex mMutex;
+        std::map<std::wstring, Entry> mEntries;
+
+        // by priority. The lowest priority comes first
+        std::map<unsigned short, Group> mGroups;
+
+        // least recently picked first. New instances have never been picked
+        std::list<std::wstring> mRecent;
+
+        // id of the last round robin pick
+        std::wstring mCursor;
+
+        std::mt19937 mRandom;
+    };
+};
@@ -0,0 +1,171 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <collection.h>
+#include <cwchar>
+
+namespace dnssd_uwp
+{
+    // DeviceWatcher property value codecs
+    struct DnssdStringCodec
+    {
+        typedef Platform::String^ Type;
+        static Type Decode(Platform::Object^ value) { return value->ToString(); }
+    };
+
+    struct DnssdStringArrayCodec
+    {
+        typedef Platform::Array<Platform::String^>^ Type;
+        static Type Decode(Platform::Object^ value) { return safe_cast<Platform::IBoxArray<Platform::String^>^>(value)->Value; }
+    };
+
+    // The DNS-SD properties read by the service watcher.
+    // Every other use of the properties is generated from this table:
+    // X(name, property key, value codec, DnssdServiceRecord field)
+#define DNSSD_PROPERTY_TABLE(X) \
+    X(HostName,       L"System.Devices.Dnssd.HostName",       DnssdStringCodec,      hostName)       \
+    X(ServiceName,    L"System.Devices.Dnssd.ServiceName",    DnssdStringCodec,      serviceName)    \
+    X(InstanceName,   L"System.Devices.Dnssd.InstanceName",   DnssdStringCodec,      instanceName)   \
+    X(IpAddress,      L"System.Devices.IpAddress",            DnssdStringArrayCodec, addresses)      \
+    X(PortNumber,     L"System.Devices.Dnssd.PortNumber",     DnssdStringCodec,      port)           \
+    X(TextAttributes, L"System.Devices.Dnssd.TextAttributes", DnssdStringArrayCodec, textAttributes) \
+    X(Priority,       L"System.Devices.Dnssd.Priority",       DnssdStringCodec,      priority)       \
+    X(Weight,         L"System.Devices.Dnssd.Weight",         DnssdStringCodec,      weight)
+
+#define DNSSD_PROPERTY_ENUM(name, key, codec, field) DnssdProperty##name,
+    enum DnssdPropertyId
+    {
+        DNSSD_PROPERTY_TABLE(DNSSD_PROPERTY_ENUM)
+        DnssdPropertyCount
+    };
+#undef DNSSD_PROPERTY_ENUM
+
+#define DNSSD_PROPERTY_BIT(id) (1u << (id))
+
+    // properties requested unless the watcher options ask for more
+    static const unsigned int DnssdDefaultPropertyMask =
+        DNSSD_PROPERTY_BIT(DnssdPropertyHostName) | DNSSD_PROPERTY_BIT(DnssdPropertyServiceName) | DNSSD_PROPERTY_BIT(DnssdPropertyInstanceName) |
+        DNSSD_PROPERTY_BIT(DnssdPropertyIpAddress) | DNSSD_PROPERTY_BIT(DnssdPropertyPortNumber) |
+        DNSSD_PROPERTY_BIT(DnssdPropertyPriority) | DNSSD_PROPERTY_BIT(DnssdPropertyWeight);
+
+    // decoded property values of one DeviceWatcher event. Properties that were not requested or not present are nullptr
+    struct DnssdServiceRecord
+    {
+        DnssdServiceRecord() : present(0) {}
+
+#define DNSSD_PROPERTY_FIELD(name, key, codec, field) codec::Type field;
+        DNSSD_PROPERTY_TABLE(DNSSD_PROPERTY_FIELD)
+#undef DNSSD_PROPERTY_FIELD
+
+        // DNSSD_PROPERTY_BIT of each decoded property. An update event only carries the properties that changed
+        unsigned int present;
+    };
+
+    template <DnssdPropertyId Id> struct DnssdProperty;
+
+#define DNSSD_PROPERTY_SPECIALIZATION(name, key, codec, field)                              \
+    template <> struct DnssdProperty<DnssdProperty##name>                                   \
+    {                                                                                       \
+        static const wchar_t* Key() { return key; }                                         \
+        static void Decode(Platform::Object^ value, DnssdServiceRecord& record)             \
+        {                                                                                   \
+            record.field = codec::Decode(value);                                            \
+        }                                                                                   \
+    };
+    DNSSD_PROPERTY_TABLE(DNSSD_PROPERTY_SPECIALIZATION)
+#undef DNSSD_PROPERTY_SPECIALIZATION
+
+    typedef Windows::Foundation::Collections::IKeyValuePair<Platform::String^, Platform::Object^> DnssdPropertyPair;
+
+    // Statically unrolled walk over the property table. Each step is resolved at
+    // compile time so the per-property decoders inline into the caller. Only the
+    // value of a key in the table is read from the pair.
+    template <int Id>
+    struct DnssdPropertyCodec
+    {
+        typedef DnssdProperty<static_cast<DnssdPropertyId>(Id)> Property;
+
+        static void Decode(const wchar_t* key, DnssdPropertyPair^ pair, unsigned int mask, DnssdServiceRecord& record)
+        {
+            if ((mask & DNSSD_PROPERTY_BIT(Id)) && wcscmp(key, Property::Key()) == 0)
+            {
+                Platform::Object^ value = pair->Value;
+                if (value != nullptr)
+                {
+                    Property::Decode(value, record);
+                    record.present |= DNSSD_PROPERTY_BIT(Id);
+                }
+                return;
+            }
+            DnssdPropertyCodec<Id + 1>::Decode(key, pair, mask, record);
+        }
+
+        static void AppendKeys(Platform::Collections::Vector<Platform::String^>^ keys, unsigned int mask)
+        {
+            if (mask & DNSSD_PROPERTY_BIT(Id))
+            {
+                keys->Append(ref new Platform::String(Property::Key()));
+            }
+            DnssdPropertyCodec<Id + 1>::AppendKeys(keys, mask);
+        }
+    };
+
+    template <>
+    struct DnssdPropertyCodec<DnssdPropertyCount>
+    {
+        static void Decode(const wchar_t* key, DnssdPropertyPair^ pair, unsigned int mask, DnssdServiceRecord& record) {}
+        static void AppendKeys(Platform::Collections::Vector<Platform::String^>^ keys, unsigned int mask) {}
+    };
+
+    // decode the properties selected by mask into record
+    inline void DecodeDnssdProperties(Windows::Foundation::Collections::IMapView<Platform::String^, Platform::Object^>^ props, unsigned int mask, DnssdServiceRecord& record)
+    {
+        // one pass over the map instead of a HasKey and a Lookup call per property. An update
+        // event only carries the properties that changed, and GetMany fetches them in one call
+        unsigned int size = props->Size;
+        if (size == 0)
+        {
+            return;
+        }
+
+        auto pairs = ref new Platform::Array<DnssdPropertyPair^>(size);
+        unsigned int count = props->First()->GetMany(pairs);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            Platform::String^ key = pairs[i]->Key;
+            DnssdPropertyCodec<0>::Decode(key->Data(), pairs[i], mask, record);
+        }
+    }
+
+    // copy the properties of update selected by mask over record
+    inline void MergeDnssdProperties(DnssdServiceRecord& record, const DnssdServiceRecord& update, unsigned int mask)
+    {
+#define DNSSD_PROPERTY_MERGE(name, key, codec, field)       \
+        if (mask & DNSSD_PROPERTY_BIT(DnssdProperty##name)) \
+        {                                                   \
+            record.field = update.field;                    \
+        }
+        DNSSD_PROPERTY_TABLE(DNSSD_PROPERTY_MERGE)
+#undef DNSSD_PROPERTY_MERGE
+        record.present |= mask;
+    }
+
+    // the DeviceWatcher property keys selected by mask
+    inline Platform::Collections::Vector<Platform::String^>^ DnssdPropertyKeys(unsigned int mask)
+    {
+        auto keys = ref new Platform::Collections::Vector<Platform::String^>();
+        DnssdPropertyCodec<0>::AppendKeys(keys, mask);
+        return keys;
+    }
+};
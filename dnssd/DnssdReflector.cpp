@@ -0,0 +1,278 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#include "DnssdReflector.h"
+#include "DnssdUtils.h"
+#include <cstdlib>
+#include <cstring>
+
+using namespace Windows::Networking;
+using namespace Windows::Networking::Connectivity;
+
+namespace dnssd_uwp
+{
+    DnssdReflector::DnssdReflector()
+        : mAdapter(nullptr)
+        , mStats()
+    {
+    }
+
+    DnssdReflector::~DnssdReflector()
+    {
+        Stop();
+    }
+
+    DnssdErrorType DnssdReflector::Initialize(const DnssdReflectorOptions& options)
+    {
+        if (options.serviceTypes == nullptr || options.serviceTypeCount == 0)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        for (unsigned int i = 0; i < options.serviceTypeCount; ++i)
+        {
+            // a type enumeration reports types, which have no host and port to announce
+            const char* serviceType = options.serviceTypes[i];
+            if (serviceType == nullptr || *serviceType == '\0' || strcmp(serviceType, DNSSD_SERVICE_TYPE_ENUMERATION) == 0)
+            {
+                return DNSSD_INVALID_PARAMETER_ERROR;
+            }
+        }
+
+        if (options.targetAddress != nullptr)
+        {
+            // the target is the adapter that owns the address
+            Platform::String^ address = StringToPlatformString(options.targetAddress);
+            auto hostNames = NetworkInformation::GetHostNames();
+            for (unsigned int i = 0; i < hostNames->Size && mAdapter == nullptr; ++i)
+            {
+                HostName^ n = hostNames->GetAt(i);
+                if ((n->Type == HostNameType::Ipv4 || n->Type == HostNameType::Ipv6) && n->IPInformation != nullptr && n->CanonicalName == address)
+                {
+                    mAdapter = n->IPInformation->NetworkAdapter;
+                }
+            }
+
+            if (mAdapter == nullptr)
+            {
+                return DNSSD_INVALID_PARAMETER_ERROR;
+            }
+        }
+
+        // the watchers browse every adapter. Without a subnet they would also follow the instances of the
+        // target, including the proxies, and reflect them back
+        if (options.sourceSubnet == nullptr || *options.sourceSubnet == '\0')
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+        mSourceSubnet = options.sourceSubnet;
+
+        // the watcher's own thread makes the callbacks, so registering a proxy never holds up the DeviceWatcher
+        DnssdServiceWatcherOptions watcherOptions = {};
+        watcherOptions.structSize = sizeof(DnssdServiceWatcherOptions);
+        watcherOptions.hostFilter = mSourceSubnet.c_str();
+        watcherOptions.executor = DNSSD_EXECUTOR_THREAD;
+
+        for (unsigned int i = 0; i < options.serviceTypeCount; ++i)
+        {
+            std::unique_ptr<Source> source(new Source());
+            source->reflector = this;
+            source->serviceType = options.serviceTypes[i];
+            source->watcher = ref new DnssdServiceWatcher(source->serviceType.c_str(), watcherOptions);
+            source->watcher->SetDnssdServiceChangedContextCallback(OnServiceChanged, source.get());
+
+            DnssdErrorType result = source->watcher->Initialize();
+            if (result != DNSSD_NO_ERROR)
+            {
+                // the failed watcher is not in mSources yet, so Stop would not reach it
+                source->watcher->Stop();
+                Stop();
+                return result;
+            }
+
+            mSources.push_back(std::move(source));
+        }
+
+        return DNSSD_NO_ERROR;
+    }
+
+    void DnssdReflector::Stop()
+    {
+        // no callbacks are made once the watchers have stopped. They take mMutex, so it is not held here
+        for (auto it = mSources.begin(); it != mSources.end(); ++it)
+        {
+            (*it)->watcher->Stop();
+        }
+        mSources.clear();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto it = mProxies.begin(); it != mProxies.end(); ++it)
+        {
+            StopProxy(it->first.first, it->second);
+        }
+        mProxies.clear();
+    }
+
+    void DnssdReflector::GetStats(DnssdReflectorStats& stats)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        stats = mStats;
+        stats.proxies = static_cast<unsigned int>(mProxies.size());
+    }
+
+    void DnssdReflector::OnServiceChanged(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context)
+    {
+        Source* source = static_cast<Source*>(context);
+        if (info != nullptr)
+        {
+            source->reflector->ReflectService(*source, update, *info);
+        }
+    }
+
+    void DnssdReflector::ReflectService(const Source& source, DnssdServiceUpdateType update, const DnssdServiceInfo& info)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        ProxyKey key(source.serviceType, info.id);
+        auto it = mProxies.find(key);
+
+        if (update == DnssdServiceUpdateType::ServiceRemoved)
+        {
+            if (it == mProxies.end())
+            {
+                ++mStats.suppressedChanges;
+                return;
+            }
+
+            StopProxy(source.serviceType, it->second);
+            mProxies.erase(it);
+            ++mStats.forwardedChanges;
+            return;
+        }
+
+        if (it == mProxies.end())
+        {
+            // one of our own proxies seen on the source, or an instance without an address to announce
+            if (IsProxyName(source.serviceType, info.instanceName) || *info.host == '\0')
+            {
+                ++mStats.suppressedChanges;
+                return;
+            }
+
+            Proxy proxy;
+            if (StartProxy(source.serviceType, info, proxy) == DNSSD_NO_ERROR)
+            {
+                mProxies[key] = proxy;
+            }
+            return;
+        }
+
+        Proxy& proxy = it->second;
+        if (proxy.instanceName == info.instanceName && proxy.host == info.host && proxy.port == info.port)
+        {
+            // a proxy carries the name, address and port only. TXT and health changes are not reflected
+            ++mStats.suppressedChanges;
+            return;
+        }
+
+        if (proxy.instanceName != info.instanceName || *info.host == '\0')
+        {
+            // a renamed instance is a different registration. Withdraw the old name first
+            StopProxy(source.serviceType, proxy);
+            mProxies.erase(it);
+            ++mStats.forwardedChanges;
+
+            Proxy renamed;
+            if (*info.host != '\0' && StartProxy(source.serviceType, info, renamed) == DNSSD_NO_ERROR)
+            {
+                mProxies[key] = renamed;
+            }
+            return;
+        }
+
+        ++mStats.forwardedChanges;
+        DnssdErrorType result = proxy.service->UpdateProxy(StringToPlatformString(info.host), static_cast<unsigned short>(atoi(info.port)));
+        if (result != DNSSD_NO_ERROR)
+        {
+            ++mStats.failedChanges;
+        }
+
+        // record the source state either way so a failed update is not retried on every unrelated event
+        proxy.host = info.host;
+        proxy.port = info.port;
+    }
+
+    DnssdErrorType DnssdReflector::StartProxy(const std::string& serviceType, const DnssdServiceInfo& info, Proxy& proxy)
+    {
+        ++mStats.forwardedChanges;
+
+        proxy.instanceName = info.instanceName;
+        proxy.registeredName = proxy.instanceName;
+        proxy.renamed = false;
+        proxy.host = info.host;
+        proxy.port = info.port;
+        proxy.service = ref new DnssdService(proxy.instanceName, serviceType, proxy.port);
+
+        DnssdErrorType result = proxy.service->StartProxy(StringToPlatformString(proxy.host), static_cast<unsigned short>(atoi(info.port)), mAdapter);
+        if (result != DNSSD_NO_ERROR)
+        {
+            ++mStats.failedChanges;
+            proxy.service = nullptr;
+            return result;
+        }
+
+        // the responder may have announced the proxy as "name (2)". The watchers see it under that name
+        proxy.registeredName = proxy.service->GetRegisteredInstanceName();
+        proxy.renamed = proxy.service->HasInstanceNameChanged();
+        mProxyNames.insert(std::make_pair(serviceType, proxy.registeredName));
+        if (proxy.renamed)
+        {
+            mRenamedProxyNames.insert(std::make_pair(serviceType, proxy.instanceName));
+        }
+        return DNSSD_NO_ERROR;
+    }
+
+    void DnssdReflector::StopProxy(const std::string& serviceType, Proxy& proxy)
+    {
+        mProxyNames.erase(std::make_pair(serviceType, proxy.registeredName));
+        if (proxy.renamed)
+        {
+            mRenamedProxyNames.erase(std::make_pair(serviceType, proxy.instanceName));
+        }
+        proxy.service->Stop();
+        proxy.service = nullptr;
+    }
+
+    bool DnssdReflector::IsProxyName(const std::string& serviceType, const std::string& instanceName)
+    {
+        if (mProxyNames.count(std::make_pair(serviceType, instanceName)) > 0)
+        {
+            return true;
+        }
+
+        // a renamed registration does not always report its new name. The responder appends " (n)" to the requested one
+        size_t open = instanceName.rfind(" (");
+        if (open == std::string::npos || instanceName.size() < open + 4 || instanceName.back() != ')')
+        {
+            return false;
+        }
+        for (size_t i = open + 2; i < instanceName.size() - 1; ++i)
+        {
+            if (instanceName[i] < '0' || instanceName[i] > '9')
+            {
+                return false;
+            }
+        }
+        return mRenamedProxyNames.count(std::make_pair(serviceType, instanceName.substr(0, open))) > 0;
+    }
+}
@@ -0,0 +1,92 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dnssd.h"
+#include "DnssdService.h"
+#include "DnssdServiceWatcher.h"
+
+namespace dnssd_uwp
+{
+    // Mirrors the instances of a list of service types from one network segment onto another.
+    // A service watcher per type follows the source and every instance it reports is announced
+    // on the target by a proxy DnssdService. Events that leave a proxy as it is are dropped here,
+    // so the target only sees traffic when an instance is added, moves or goes away.
+    class DnssdReflector
+    {
+    public:
+        DnssdReflector();
+        ~DnssdReflector();
+
+        DnssdErrorType Initialize(const DnssdReflectorOptions& options);
+
+        // stop the watchers, then withdraw the proxies
+        void Stop();
+
+        void GetStats(DnssdReflectorStats& stats);
+
+    private:
+        // one allow-listed service type and the watcher following it on the source
+        struct Source
+        {
+            DnssdReflector* reflector;
+            std::string serviceType;
+            DnssdServiceWatcher^ watcher;
+        };
+
+        // announcement on the target of one source instance
+        struct Proxy
+        {
+            std::string instanceName;               // name of the source instance
+            std::string registeredName;             // name the responder announces the proxy under
+            bool renamed;                           // the responder resolved a name conflict by renaming the proxy
+            std::string host;
+            std::string port;
+            DnssdService^ service;
+        };
+
+        // service type and source service id
+        typedef std::pair<std::string, std::string> ProxyKey;
+
+        static void OnServiceChanged(const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context);
+        void ReflectService(const Source& source, DnssdServiceUpdateType update, const DnssdServiceInfo& info);
+        DnssdErrorType StartProxy(const std::string& serviceType, const DnssdServiceInfo& info, Proxy& proxy);
+        void StopProxy(const std::string& serviceType, Proxy& proxy);
+        bool IsProxyName(const std::string& serviceType, const std::string& instanceName);
+
+        std::vector<std::unique_ptr<Source>> mSources;
+        std::string mSourceSubnet;
+        Windows::Networking::Connectivity::NetworkAdapter^ mAdapter;
+
+        // registrations are made with the lock held, so the watchers of different types take turns
+        std::mutex mMutex;
+        std::map<ProxyKey, Proxy> mProxies;
+
+        // service type and registered instance name of every proxy. The source watchers see the proxies too and must not reflect them again
+        std::set<std::pair<std::string, std::string>> mProxyNames;
+
+        // service type and source instance name of the proxies the responder renamed
+        std::set<std::pair<std::string, std::string>> mRenamedProxyNames;
+
+        DnssdReflectorStats mStats;
+    };
+};
@@ -0,0 +1,158 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdScheduler.h"
+#include <vector>
+
+using namespace Windows::Foundation;
+using namespace Windows::System::Threading;
+
+namespace dnssd_uwp
+{
+    DnssdScheduler& DnssdScheduler::Instance()
+    {
+        static DnssdScheduler scheduler;
+        return scheduler;
+    }
+
+    DnssdScheduler::DnssdScheduler()
+        : mNextId(1)
+        , mArmed(false)
+    {
+    }
+
+    DnssdTimerId DnssdScheduler::Schedule(unsigned int delayMilliseconds, Task task)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        DnssdTimerId id = mNextId++;
+        TimePoint deadline = DnssdClock::Current().Now() + std::chrono::milliseconds(delayMilliseconds);
+        mTimers[TimerKey(deadline, id)] = task;
+        mDeadlines[id] = deadline;
+
+        Arm();
+        return id;
+    }
+
+    void DnssdScheduler::Cancel(DnssdTimerId id)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mDeadlines.find(id);
+        if (it == mDeadlines.end())
+        {
+            return;
+        }
+
+        mTimers.erase(TimerKey(it->second, id));
+        mDeadlines.erase(it);
+
+        // the armed timer is left alone. If it fires early it finds nothing due and re-arms
+    }
+
+    // must be called with mMutex held
+    void DnssdScheduler::Arm()
+    {
+        // a manual clock runs the due tasks itself when it is advanced
+        if (mTimers.empty() || DnssdClock::Current().IsManual())
+        {
+            return;
+        }
+
+        TimePoint next = mTimers.begin()->first.first;
+        if (mArmed && mArmedDeadline <= next)
+        {
+            // the armed timer fires first and will re-arm for this deadline
+            return;
+        }
+
+        if (mTimer != nullptr)
+        {
+            mTimer->Cancel();
+        }
+
+        // round up so the timer never fires before the deadline
+        auto delay = std::chrono::duration_cast<std::chrono::microseconds>(next - DnssdClock::Current().Now()).count();
+        TimeSpan period;
+        period.Duration = (delay > 0 ? (delay + 999) / 1000 : 0) * 10000LL; // TimeSpan is in 100ns units
+
+        mArmed = true;
+        mArmedDeadline = next;
+        mTimer = ThreadPoolTimer::CreateTimer(ref new TimerElapsedHandler([this](ThreadPoolTimer^ timer)
+        {
+            OnTimer(timer);
+        }), period);
+    }
+
+    void DnssdScheduler::OnTimer(ThreadPoolTimer^ timer)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // a timer replaced by Arm() may still fire. Only the current one clears the armed state
+            if (timer == mTimer)
+            {
+                mArmed = false;
+                mTimer = nullptr;
+            }
+        }
+
+        RunDue();
+    }
+
+    void DnssdScheduler::RunDue()
+    {
+        for (;;)
+        {
+            std::vector<std::pair<DnssdTimerId, Task>> due;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                TimePoint now = DnssdClock::Current().Now();
+                while (!mTimers.empty() && mTimers.begin()->first.first <= now)
+                {
+                    auto it = mTimers.begin();
+                    due.push_back(std::make_pair(it->first.second, it->second));
+                    mDeadlines.erase(it->first.second);
+                    mTimers.erase(it);
+                }
+            }
+
+            if (due.empty())
+            {
+                break;
+            }
+
+            // run the tasks without holding the lock so they can schedule and cancel timers
+            for (auto it = due.begin(); it != due.end(); ++it)
+            {
+                it->second(it->first);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        Arm();
+    }
+
+    bool DnssdScheduler::NextDeadline(TimePoint& next)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mTimers.empty())
+        {
+            return false;
+        }
+
+        next = mTimers.begin()->first.first;
+        return true;
+    }
+}
@@ -0,0 +1,75 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "DnssdClock.h"
+
+namespace dnssd_uwp
+{
+    typedef unsigned long long DnssdTimerId;
+
+    // Process wide timer queue shared by every watcher and service.
+    // All timers are multiplexed onto a single thread pool timer armed for the
+    // earliest deadline, so the number of wakeups does not grow with the number
+    // of watchers or pending timers. Deadlines are kept on DnssdClock::Current(); with a
+    // manual clock nothing runs until the clock is advanced.
+    class DnssdScheduler
+    {
+    public:
+        // id is the timer that ran, as returned by Schedule
+        typedef std::function<void(DnssdTimerId id)> Task;
+        typedef DnssdClock::TimePoint TimePoint;
+
+        static DnssdScheduler& Instance();
+
+        // run task once after delayMilliseconds. Returns an id for Cancel. Never returns 0.
+        // Due tasks run one after another on a shared thread, so a task must not block or call into the client
+        DnssdTimerId Schedule(unsigned int delayMilliseconds, Task task);
+
+        // cancel a pending task. Does nothing if the task has already run or been taken to run.
+        // A task that may be stale compares its id with the one its owner holds
+        void Cancel(DnssdTimerId id);
+
+        // run the tasks that are due on the calling thread. Called by the timer and by a manual clock
+        void RunDue();
+
+        // earliest pending deadline. Returns false if nothing is scheduled
+        bool NextDeadline(TimePoint& next);
+
+    private:
+        DnssdScheduler();
+        DnssdScheduler(const DnssdScheduler&) = delete;
+        DnssdScheduler& operator=(const DnssdScheduler&) = delete;
+
+        void Arm();
+        void OnTimer(Windows::System::Threading::ThreadPoolTimer^ timer);
+
+        typedef std::pair<TimePoint, DnssdTimerId> TimerKey;
+
+        std::map<TimerKey, Task> mTimers;
+        std::unordered_map<DnssdTimerId, TimePoint> mDeadlines;
+        DnssdTimerId mNextId;
+
+        Windows::System::Threading::ThreadPoolTimer^ mTimer;
+        TimePoint mArmedDeadline;
+        bool mArmed;
+
+        std::mutex mMutex;
+    };
+};
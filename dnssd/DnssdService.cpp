@@ -15,6 +15,8 @@
 #include "Dnssdutils.h"
 #include <ppltasks.h>
 #include <stdlib.h>
+#include <utility>
+#include <vector>
 
 using namespace dnssd_uwp;
 using namespace concurrency;
@@ -24,21 +26,82 @@ using namespace Windows::Networking::Connectivity;
 using namespace Windows::Networking::Sockets;
 using namespace Windows::Networking::ServiceDiscovery::Dnssd;
 
-DnssdService::DnssdService(const std::string& name, const std::string& port)
+DnssdService::DnssdService(const std::string& instanceName, const std::string& name, const std::string& port)
+    : mInstanceNameChanged(false)
 {
-    mServiceName = StringToPlatformString(name);
+    // instance names are UTF-8, like the names the watchers report
+    mInstanceName = ref new Platform::String(Utf8ToWideString(instanceName.c_str()).c_str());
+    mServiceName = ref new Platform::String(Utf8ToWideString(name.c_str()).c_str());
     mPort = StringToPlatformString(port);
 }
 
+typedef std::vector<std::pair<Platform::String^, Platform::String^>> DnssdTextAttributes;
+
+static void SetTextAttributes(DnssdServiceInstance^ service, const DnssdTextAttributes& text)
+{
+    auto textAttributes = service->TextAttributes;
+    textAttributes->Clear();
+    for (auto it = text.begin(); it != text.end(); ++it)
+    {
+        textAttributes->Insert(it->first, it->second);
+    }
+}
+
 DnssdService::~DnssdService()
 {
     DnssdService::Stop();
 }
 
-DnssdErrorType DnssdService::Start()
+// wait for a registration started by Start or Update and map its status. instanceNameChanged is set
+// if the responder registered the instance under another name
+static DnssdErrorType WaitForRegistration(task<DnssdRegistrationResult^> task, bool* instanceNameChanged = nullptr)
 {
     DnssdErrorType result = DNSSD_NO_ERROR;
 
+    try
+    {
+        // wait for dnssd service to start
+        DnssdRegistrationResult^ reg = task.get(); // will also rethrow any exceptions from above task
+        auto ip = reg->IPAddress; // this always seems to be NULL
+        auto status = reg->Status;
+        bool hasInstanceChanged = reg->HasInstanceNameChanged;
+        if (instanceNameChanged != nullptr && status == DnssdRegistrationStatus::Success)
+        {
+            *instanceNameChanged = hasInstanceChanged;
+        }
+
+        if (status != DnssdRegistrationStatus::Success)
+        {
+            switch (status)
+            {
+                case DnssdRegistrationStatus::InvalidServiceName:
+                    result = DNSSD_INVALID_SERVICE_NAME_ERROR;
+                    break;
+                case DnssdRegistrationStatus::SecurityError:
+                    result = DNSSD_SERVICE_SECURITY_ERROR;
+                    break;
+                case DnssdRegistrationStatus::ServerError:
+                    result = DNSSD_SERVICE_SERVER_ERROR;
+                    break;
+                default:
+                    result = DNSSD_SERVICE_INITIALIZATION_ERROR;
+                    break;
+            }
+
+        }
+        return result;
+    }
+    catch (Platform::Exception^ ex)
+    {
+        result =  DNSSD_SERVICE_INITIALIZATION_ERROR;
+    }
+
+    return result;
+}
+
+DnssdErrorType DnssdService::Start()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mService != nullptr)
     {
         return DNSSD_SERVICE_ALREADY_EXISTS_ERROR;
@@ -74,57 +137,182 @@ DnssdErrorType DnssdService::Start()
         mSocketToken = mSocket->ConnectionReceived += ref new TypedEventHandler<StreamSocketListener^, StreamSocketListenerConnectionReceivedEventArgs ^>(this, &DnssdService::OnConnect);
         create_task(mSocket->BindServiceNameAsync(mPort)).get();
         unsigned short port = static_cast<unsigned short>(_wtoi(mSocket->Information->LocalPort->Data()));
-        mService = ref new DnssdServiceInstance(L"dnssd." + mServiceName + L".local", hostName, port);
+        mService = ref new DnssdServiceInstance(mInstanceName + L"." + mServiceName + L".local", hostName, port);
         return create_task(mService->RegisterStreamSocketListenerAsync(mSocket));
     }));
 
-    try
+    return WaitForRegistration(task);
+}
+
+DnssdErrorType DnssdService::Update(const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port)
+{
+    DnssdTextAttributes text;
+    for (unsigned int i = 0; i < attributeCount; ++i)
     {
-        // wait for dnssd service to start
-        DnssdRegistrationResult^ reg = task.get(); // will also rethrow any exceptions from above task
-        auto ip = reg->IPAddress; // this always seems to be NULL
-        auto status = reg->Status;
-        bool hasInstanceChanged = reg->HasInstanceNameChanged;
+        if (attributes[i].key == nullptr || *attributes[i].key == '\0')
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
 
-        if (status != DnssdRegistrationStatus::Success)
+        Platform::String^ key = ref new Platform::String(Utf8ToWideString(attributes[i].key).c_str());
+        Platform::String^ value = ref new Platform::String(attributes[i].value != nullptr ? Utf8ToWideString(attributes[i].value).c_str() : L"");
+        text.push_back(std::make_pair(key, value));
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mService == nullptr)
+    {
+        return DNSSD_SERVICE_INITIALIZATION_ERROR;
+    }
+
+    DnssdServiceInstance^ service = mService;
+    Platform::String^ newPort = port != nullptr ? StringToPlatformString(port) : mPort;
+    bool movePort = newPort != mPort;
+
+    // kept to roll the instance back if the update fails
+    unsigned short oldPort = service->Port;
+    DnssdTextAttributes oldText;
+    for (auto it = service->TextAttributes->First(); it->HasCurrent; it->MoveNext())
+    {
+        oldText.push_back(std::make_pair(it->Current->Key, it->Current->Value));
+    }
+
+    // the task is waited for below, so it may fill in these locals
+    StreamSocketListener^ socket = mSocket;
+    StreamSocketListener^ newSocket = nullptr;
+    EventRegistrationToken newToken;
+
+    auto task = create_task(create_async([this, service, text, newPort, movePort, &socket, &newSocket, &newToken]
+    {
+        if (movePort)
         {
-            switch (status)
-            {
-                case DnssdRegistrationStatus::InvalidServiceName:
-                    result = DNSSD_INVALID_SERVICE_NAME_ERROR;
-                    break;
-                case DnssdRegistrationStatus::SecurityError:
-                    result = DNSSD_SERVICE_SECURITY_ERROR;
-                    break;
-                case DnssdRegistrationStatus::ServerError:
-                    result = DNSSD_SERVICE_SERVER_ERROR;
-                    break;
-                default:
-                    result = DNSSD_SERVICE_INITIALIZATION_ERROR;
-                    break;
-            }
+            // bind the new listener before the instance is touched. The old one is closed once the registration succeeded
+            newSocket = ref new StreamSocketListener();
+            newToken = newSocket->ConnectionReceived += ref new TypedEventHandler<StreamSocketListener^, StreamSocketListenerConnectionReceivedEventArgs ^>(this, &DnssdService::OnConnect);
+            create_task(newSocket->BindServiceNameAsync(newPort)).get();
+            service->Port = static_cast<unsigned short>(_wtoi(newSocket->Information->LocalPort->Data()));
+            socket = newSocket;
+        }
 
+        // registering the same instance again re-announces it under its current name
+        SetTextAttributes(service, text);
+        return create_task(service->RegisterStreamSocketListenerAsync(socket));
+    }));
+
+    DnssdErrorType result = WaitForRegistration(task);
+    if (result != DNSSD_NO_ERROR)
+    {
+        // the instance keeps its previous TXT attributes, port and listener
+        SetTextAttributes(service, oldText);
+        service->Port = oldPort;
+        if (newSocket != nullptr)
+        {
+            CloseListener(newSocket, newToken);
         }
         return result;
     }
-    catch (Platform::Exception^ ex)
+
+    if (newSocket != nullptr)
     {
-        result =  DNSSD_SERVICE_INITIALIZATION_ERROR;
+        CloseListener(mSocket, mSocketToken);
+        mSocket = newSocket;
+        mSocketToken = newToken;
+        mPort = newPort;
     }
 
-    return result;
+    return DNSSD_NO_ERROR;
+}
+
+DnssdErrorType DnssdService::StartProxy(Platform::String^ host, unsigned short port, NetworkAdapter^ adapter)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mService != nullptr)
+    {
+        return DNSSD_SERVICE_ALREADY_EXISTS_ERROR;
+    }
+
+    auto task = create_task(create_async([this, host, port, adapter]
+    {
+        // nothing connects to a proxy. Any free port will do for the listener
+        mSocket = ref new StreamSocketListener();
+        mSocketToken = mSocket->ConnectionReceived += ref new TypedEventHandler<StreamSocketListener^, StreamSocketListenerConnectionReceivedEventArgs ^>(this, &DnssdService::OnConnect);
+        create_task(mSocket->BindServiceNameAsync(L"")).get();
+        mService = ref new DnssdServiceInstance(mInstanceName + L"." + mServiceName + L".local", ref new HostName(host), port);
+        mAdapter = adapter;
+        if (adapter != nullptr)
+        {
+            return create_task(mService->RegisterStreamSocketListenerAsync(mSocket, adapter));
+        }
+        return create_task(mService->RegisterStreamSocketListenerAsync(mSocket));
+    }));
+
+    return WaitForRegistration(task, &mInstanceNameChanged);
+}
+
+DnssdErrorType DnssdService::UpdateProxy(Platform::String^ host, unsigned short port)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mService == nullptr)
+    {
+        return DNSSD_SERVICE_INITIALIZATION_ERROR;
+    }
+
+    auto task = create_task(create_async([this, host, port]
+    {
+        mService->HostName = ref new HostName(host);
+        mService->Port = port;
+
+        // registering the same instance again re-announces it under its current name
+        if (mAdapter != nullptr)
+        {
+            return create_task(mService->RegisterStreamSocketListenerAsync(mSocket, mAdapter));
+        }
+        return create_task(mService->RegisterStreamSocketListenerAsync(mSocket));
+    }));
+
+    return WaitForRegistration(task);
+}
+
+std::string DnssdService::GetRegisteredInstanceName()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::wstring name(mInstanceName->Data());
+    if (mService != nullptr)
+    {
+        // the registered name is the full "instance._type._tcp.local"
+        std::wstring fullName(mService->DnssdServiceInstanceName->Data());
+        std::wstring suffix = std::wstring(L".") + mServiceName->Data() + L".local";
+        if (fullName.size() > suffix.size() && fullName.compare(fullName.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            name = fullName.substr(0, fullName.size() - suffix.size());
+        }
+    }
+    return WideStringToUtf8(name);
+}
+
+bool DnssdService::HasInstanceNameChanged()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mInstanceNameChanged;
 }
 
 void DnssdService::Stop()
 {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mSocket != nullptr)
     {
-        mSocket->ConnectionReceived -= mSocketToken;
-        delete mSocket;
+        CloseListener(mSocket, mSocketToken);
         mSocket = nullptr;
     }
 
     mService = nullptr;
+    mAdapter = nullptr;
+}
+
+void DnssdService::CloseListener(StreamSocketListener^ socket, EventRegistrationToken token)
+{
+    socket->ConnectionReceived -= token;
+    delete socket;
 }
 
 void DnssdService::OnConnect(StreamSocketListener^ sender, StreamSocketListenerConnectionReceivedEventArgs ^ args)
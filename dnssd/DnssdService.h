@@ -13,6 +13,7 @@
 #pragma once
 
 #include "dnssd.h"
+#include <mutex>
 #include <string>
 
 namespace dnssd_uwp
@@ -23,17 +24,36 @@ namespace dnssd_uwp
         virtual ~DnssdService();
 
     internal:
-        DnssdService(const std::string& name, const std::string& port);
+        DnssdService(const std::string& instanceName, const std::string& name, const std::string& port);
         DnssdErrorType Start();
+        DnssdErrorType Update(const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port);
         void Stop();
 
+        // register the instance on behalf of another host. host and port are announced instead of this
+        // machine's, and the listener only holds the registration. adapter may be nullptr for every adapter
+        DnssdErrorType StartProxy(Platform::String^ host, unsigned short port, Windows::Networking::Connectivity::NetworkAdapter^ adapter);
+
+        // move a proxy registration to a new host or port and re-announce it
+        DnssdErrorType UpdateProxy(Platform::String^ host, unsigned short port);
+
+        // the instance name the responder registered, and whether it replaced the requested name to resolve a conflict
+        std::string GetRegisteredInstanceName();
+        bool HasInstanceNameChanged();
+
     private:
         void OnConnect(Windows::Networking::Sockets::StreamSocketListener^ sender, Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs ^ args);
+        void CloseListener(Windows::Networking::Sockets::StreamSocketListener^ socket, Windows::Foundation::EventRegistrationToken token);
+
+        // serializes Start, Update and Stop. The registration and listener below are only replaced under it
+        std::mutex mMutex;
+        Platform::String^ mInstanceName;
         Platform::String^ mServiceName;
         Platform::String^ mPort;
         Windows::Networking::ServiceDiscovery::Dnssd::DnssdServiceInstance^ mService;
         Windows::Networking::Sockets::StreamSocketListener^ mSocket;
         Windows::Foundation::EventRegistrationToken mSocketToken;
+        Windows::Networking::Connectivity::NetworkAdapter^ mAdapter;
+        bool mInstanceNameChanged;
     };
 
     class DnssdServiceWrapper
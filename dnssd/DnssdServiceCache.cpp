@@ -0,0 +1,201 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdServiceCache.h"
+#include "DnssdClock.h"
+#include <cstring>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace dnssd_uwp
+{
+    // file layout. All integers are little endian
+    //   header: magic, version, entry count, service name
+    //   entry:  expires, id, instance name, host, port
+    // strings are a 16 bit length in characters followed by UTF-16 data
+    static const unsigned int CacheMagic = 0x43535344; // "DSSC"
+    static const unsigned int CacheVersion = 1;
+
+    // bounds checked reader over the mapped file
+    class CacheReader
+    {
+    public:
+        CacheReader(const unsigned char* data, size_t size)
+            : mData(data)
+            , mSize(size)
+            , mOffset(0)
+        {
+        }
+
+        template <typename T>
+        bool Read(T& value)
+        {
+            if (mSize - mOffset < sizeof(T))
+            {
+                return false;
+            }
+            memcpy(&value, mData + mOffset, sizeof(T));
+            mOffset += sizeof(T);
+            return true;
+        }
+
+        bool ReadString(std::wstring& value)
+        {
+            unsigned short length = 0;
+            if (!Read(length) || mSize - mOffset < length * sizeof(wchar_t))
+            {
+                return false;
+            }
+            value.assign(reinterpret_cast<const wchar_t*>(mData + mOffset), length);
+            mOffset += length * sizeof(wchar_t);
+            return true;
+        }
+
+    private:
+        const unsigned char* mData;
+        size_t mSize;
+        size_t mOffset;
+    };
+
+    template <typename T>
+    static void Write(std::vector<unsigned char>& buffer, const T& value)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    static void WriteString(std::vector<unsigned char>& buffer, const std::wstring& value)
+    {
+        unsigned short length = static_cast<unsigned short>(value.size() < 0xffff ? value.size() : 0xffff);
+        Write(buffer, length);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(value.data());
+        buffer.insert(buffer.end(), bytes, bytes + length * sizeof(wchar_t));
+    }
+
+    DnssdServiceCache::DnssdServiceCache(const std::wstring& path, const std::wstring& serviceName)
+        : mPath(path)
+        , mServiceName(serviceName)
+    {
+    }
+
+    unsigned long long DnssdServiceCache::Now()
+    {
+        return DnssdClock::Current().SystemTime();
+    }
+
+    bool DnssdServiceCache::Load(std::vector<DnssdCacheEntry>& entries)
+    {
+        HANDLE file = CreateFileW(mPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            return false;
+        }
+
+        const unsigned char* view = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (view == nullptr)
+        {
+            return false;
+        }
+
+        bool result = false;
+        CacheReader reader(view, static_cast<size_t>(fileSize.QuadPart));
+        unsigned int magic = 0;
+        unsigned int version = 0;
+        unsigned int count = 0;
+        std::wstring serviceName;
+
+        // a cache from another version or for another service type is ignored
+        if (reader.Read(magic) && magic == CacheMagic &&
+            reader.Read(version) && version == CacheVersion &&
+            reader.Read(count) &&
+            reader.ReadString(serviceName) && serviceName == mServiceName)
+        {
+            unsigned long long now = Now();
+            result = true;
+
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                DnssdCacheEntry entry;
+                if (!reader.Read(entry.expires) ||
+                    !reader.ReadString(entry.id) ||
+                    !reader.ReadString(entry.instanceName) ||
+                    !reader.ReadString(entry.host) ||
+                    !reader.ReadString(entry.port))
+                {
+                    // truncated file. Keep what was read
+                    break;
+                }
+
+                if (entry.expires > now)
+                {
+                    entries.push_back(entry);
+                }
+            }
+        }
+
+        UnmapViewOfFile(view);
+        return result;
+    }
+
+    bool DnssdServiceCache::Save(const std::vector<DnssdCacheEntry>& entries)
+    {
+        std::vector<unsigned char> buffer;
+        Write(buffer, CacheMagic);
+        Write(buffer, CacheVersion);
+        Write(buffer, static_cast<unsigned int>(entries.size()));
+        WriteString(buffer, mServiceName);
+
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            Write(buffer, it->expires);
+            WriteString(buffer, it->id);
+            WriteString(buffer, it->instanceName);
+            WriteString(buffer, it->host);
+            WriteString(buffer, it->port);
+        }
+
+        std::wstring temp = mPath + L".tmp";
+        HANDLE file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        DWORD written = 0;
+        BOOL ok = WriteFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &written, nullptr);
+        CloseHandle(file);
+
+        if (!ok || written != buffer.size() || !MoveFileExW(temp.c_str(), mPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileW(temp.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,54 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace dnssd_uwp
+{
+    // one service saved in the warm-start cache
+    struct DnssdCacheEntry
+    {
+        std::wstring id;
+        std::wstring instanceName;
+        std::wstring host;
+        std::wstring port;
+        unsigned long long expires; // UTC FILETIME after which the entry is ignored
+    };
+
+    // On-disk table of the services a watcher last knew about.
+    // The file is versioned and tagged with the service type, and is read through a
+    // read-only memory mapping. Saves go to a temporary file that replaces the cache
+    // in one step so a crash never leaves a partial table behind.
+    class DnssdServiceCache
+    {
+    public:
+        DnssdServiceCache(const std::wstring& path, const std::wstring& serviceName);
+
+        // load the unexpired entries. Returns false if there is no usable cache
+        bool Load(std::vector<DnssdCacheEntry>& entries);
+
+        bool Save(const std::vector<DnssdCacheEntry>& entries);
+
+        // current UTC time as a FILETIME
+        static unsigned long long Now();
+
+        // FILETIME ticks per second
+        static const unsigned long long TicksPerSecond = 10000000ULL;
+
+    private:
+        std::wstring mPath;
+        std::wstring mServiceName;
+    };
+};
@@ -0,0 +1,216 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdServiceFilter.h"
+#include "DnssdUtils.h"
+#include <cwctype>
+#include <cstring>
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+// needed for InetPton
+#pragma comment(lib, "ws2_32.lib")
+
+namespace dnssd_uwp
+{
+    DnssdServiceFilter::DnssdServiceFilter()
+        : mHasInstanceNameFilter(false)
+        , mHasHostFilter(false)
+        , mHasTxtKeyFilter(false)
+        , mIsSubnet(false)
+        , mAddressFamily(AF_UNSPEC)
+        , mPrefixLength(0)
+    {
+        memset(mAddress, 0, sizeof(mAddress));
+    }
+
+    DnssdErrorType DnssdServiceFilter::Compile(const DnssdServiceWatcherOptions& options)
+    {
+        if (options.instanceNameFilter != nullptr && *options.instanceNameFilter != '\0')
+        {
+            mInstanceNamePattern = Utf8ToWideString(options.instanceNameFilter);
+            mHasInstanceNameFilter = true;
+        }
+
+        if (options.txtKeyFilter != nullptr && *options.txtKeyFilter != '\0')
+        {
+            mTxtKey = Utf8ToWideString(options.txtKeyFilter);
+            mHasTxtKeyFilter = true;
+        }
+
+        if (options.hostFilter != nullptr && *options.hostFilter != '\0')
+        {
+            std::wstring host = Utf8ToWideString(options.hostFilter);
+            mHasHostFilter = true;
+
+            if (!ParseSubnet(host))
+            {
+                // a '/' means the caller meant a subnet
+                if (host.find(L'/') != std::wstring::npos)
+                {
+                    return DNSSD_INVALID_PARAMETER_ERROR;
+                }
+                mHostName = host;
+            }
+        }
+
+        return DNSSD_NO_ERROR;
+    }
+
+    bool DnssdServiceFilter::ParseSubnet(const std::wstring& subnet)
+    {
+        std::wstring address = subnet;
+        unsigned int maxPrefix = 0;
+        auto slash = subnet.find(L'/');
+        if (slash != std::wstring::npos)
+        {
+            address = subnet.substr(0, slash);
+        }
+
+        if (InetPtonW(AF_INET, address.c_str(), mAddress) == 1)
+        {
+            mAddressFamily = AF_INET;
+            maxPrefix = 32;
+        }
+        else if (InetPtonW(AF_INET6, address.c_str(), mAddress) == 1)
+        {
+            mAddressFamily = AF_INET6;
+            maxPrefix = 128;
+        }
+        else
+        {
+            return false;
+        }
+
+        mPrefixLength = maxPrefix;
+        if (slash != std::wstring::npos)
+        {
+            wchar_t* end = nullptr;
+            unsigned long prefix = wcstoul(subnet.c_str() + slash + 1, &end, 10);
+            if (end == subnet.c_str() + slash + 1 || *end != L'\0' || prefix > maxPrefix)
+            {
+                return false;
+            }
+            mPrefixLength = prefix;
+        }
+
+        mIsSubnet = true;
+        return true;
+    }
+
+    bool DnssdServiceFilter::MatchInstanceName(const wchar_t* name) const
+    {
+        if (!mHasInstanceNameFilter)
+        {
+            return true;
+        }
+
+        // iterative glob match with single star backtracking
+        const wchar_t* pattern = mInstanceNamePattern.c_str();
+        const wchar_t* star = nullptr;
+        const wchar_t* resume = nullptr;
+
+        while (*name != L'\0')
+        {
+            if (*pattern == L'*')
+            {
+                star = pattern++;
+                resume = name;
+            }
+            else if (*pattern == L'?' || (*pattern != L'\0' && towlower(*pattern) == towlower(*name)))
+            {
+                ++pattern;
+                ++name;
+            }
+            else if (star != nullptr)
+            {
+                pattern = star + 1;
+                name = ++resume;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        while (*pattern == L'*')
+        {
+            ++pattern;
+        }
+
+        return *pattern == L'\0';
+    }
+
+    bool DnssdServiceFilter::MatchAddress(const wchar_t* address) const
+    {
+        if (!mHasHostFilter)
+        {
+            return true;
+        }
+
+        if (!mIsSubnet)
+        {
+            return _wcsicmp(address, mHostName.c_str()) == 0;
+        }
+
+        unsigned char bytes[16];
+        if (InetPtonW(mAddressFamily, address, bytes) != 1)
+        {
+            return false;
+        }
+
+        unsigned int fullBytes = mPrefixLength / 8;
+        if (memcmp(bytes, mAddress, fullBytes) != 0)
+        {
+            return false;
+        }
+
+        unsigned int remainingBits = mPrefixLength % 8;
+        if (remainingBits == 0)
+        {
+            return true;
+        }
+
+        unsigned char mask = static_cast<unsigned char>(0xff << (8 - remainingBits));
+        return (bytes[fullBytes] & mask) == (mAddress[fullBytes] & mask);
+    }
+
+    bool DnssdServiceFilter::MatchHostName(const wchar_t* hostName) const
+    {
+        if (!mHasHostFilter)
+        {
+            return true;
+        }
+
+        if (mIsSubnet)
+        {
+            return false;
+        }
+
+        // accept the host name with or without the .local suffix
+        size_t length = mHostName.size();
+        return _wcsnicmp(hostName, mHostName.c_str(), length) == 0 && (hostName[length] == L'\0' || hostName[length] == L'.');
+    }
+
+    bool DnssdServiceFilter::MatchTxtAttribute(const wchar_t* attribute) const
+    {
+        if (!mHasTxtKeyFilter)
+        {
+            return true;
+        }
+
+        // TXT keys are case insensitive and end at the first '='
+        size_t length = mTxtKey.size();
+        return _wcsnicmp(attribute, mTxtKey.c_str(), length) == 0 && (attribute[length] == L'\0' || attribute[length] == L'=');
+    }
+}
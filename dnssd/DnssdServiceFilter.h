@@ -0,0 +1,65 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dnssd.h"
+
+namespace dnssd_uwp
+{
+    // Service watcher filters compiled from DnssdServiceWatcherOptions.
+    // All matching is done on the raw UTF-16 property data so rejected services
+    // are never converted to UTF-8 or reported to the client.
+    class DnssdServiceFilter
+    {
+    public:
+        DnssdServiceFilter();
+
+        // compile the filters. The option strings are not referenced after this call
+        DnssdErrorType Compile(const DnssdServiceWatcherOptions& options);
+
+        bool HasInstanceNameFilter() const { return mHasInstanceNameFilter; }
+        bool HasHostFilter() const { return mHasHostFilter; }
+        bool HasTxtKeyFilter() const { return mHasTxtKeyFilter; }
+        bool HasFilters() const { return mHasInstanceNameFilter || mHasHostFilter || mHasTxtKeyFilter; }
+
+        // case insensitive glob match ('*' and '?') against the instance name
+        bool MatchInstanceName(const wchar_t* name) const;
+
+        // match an IP address against the subnet filter, or a host name against the host filter
+        bool MatchAddress(const wchar_t* address) const;
+        bool MatchHostName(const wchar_t* hostName) const;
+
+        // match one "key=value" TXT attribute against the TXT key filter
+        bool MatchTxtAttribute(const wchar_t* attribute) const;
+
+    private:
+        bool ParseSubnet(const std::wstring& subnet);
+
+        bool mHasInstanceNameFilter;
+        bool mHasHostFilter;
+        bool mHasTxtKeyFilter;
+
+        std::wstring mInstanceNamePattern;
+        std::wstring mTxtKey;
+
+        // host filter is either a host name or an address with a prefix length
+        std::wstring mHostName;
+        bool mIsSubnet;
+        int mAddressFamily;
+        unsigned char mAddress[16];
+        unsigned int mPrefixLength;
+    };
+};
@@ -0,0 +1,246 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#include "DnssdServiceTable.h"
+#include <cwchar>
+
+namespace dnssd_uwp
+{
+    // buckets of a new index. Grown by doubling whenever it is half full
+    static const unsigned int InitialBucketBits = 4;
+
+    // size of the HSTRING header in front of the characters. Memory figures are estimates
+    static const size_t StringHeaderBytes = 24;
+
+    static size_t StringBytes(Platform::String^ s)
+    {
+        return s == nullptr ? 0 : StringHeaderBytes + (s->Length() + 1) * sizeof(wchar_t);
+    }
+
+    static bool SameString(Platform::String^ a, Platform::String^ b)
+    {
+        return a->Length() == b->Length() && wmemcmp(a->Data(), b->Data(), a->Length()) == 0;
+    }
+
+    DnssdStringPool::DnssdStringPool()
+        : mCharacterBytes(0)
+    {
+    }
+
+    Platform::String^ DnssdStringPool::Intern(Platform::String^ s)
+    {
+        if (s == nullptr)
+        {
+            return nullptr;
+        }
+
+        auto it = mStrings.find(s);
+        if (it != mStrings.end())
+        {
+            ++it->second;
+            return it->first;
+        }
+
+        mStrings.emplace(s, 1);
+        mCharacterBytes += StringBytes(s);
+        return s;
+    }
+
+    void DnssdStringPool::Release(Platform::String^ s)
+    {
+        if (s == nullptr)
+        {
+            return;
+        }
+
+        auto it = mStrings.find(s);
+        if (it != mStrings.end() && --it->second == 0)
+        {
+            mCharacterBytes -= StringBytes(it->first);
+            mStrings.erase(it);
+        }
+    }
+
+    size_t DnssdStringPool::MemoryBytes() const
+    {
+        // a node holds the entry, the cached hash and the list link
+        size_t nodeBytes = sizeof(std::pair<Platform::String^, unsigned int>) + sizeof(size_t) + sizeof(void*);
+        return mCharacterBytes + mStrings.size() * nodeBytes + mStrings.bucket_count() * sizeof(void*);
+    }
+
+    DnssdServiceTable::DnssdServiceTable()
+        : mBucketBits(0)
+        , mCount(0)
+        , mIdBytes(0)
+    {
+    }
+
+    size_t DnssdServiceTable::Bucket(unsigned int hash) const
+    {
+        // the shard index already took the hash modulo the shard count, so its low bits are
+        // the same for every id in the table. Fibonacci hashing takes the high bits of the product
+        return static_cast<size_t>((hash * 2654435769u) >> (32 - mBucketBits));
+    }
+
+    DnssdServiceInstance* DnssdServiceTable::Find(Platform::String^ id)
+    {
+        if (mBuckets.empty() || id == nullptr)
+        {
+            return nullptr;
+        }
+
+        unsigned int hash = DnssdHashString(id->Data(), id->Length());
+        size_t mask = mBuckets.size() - 1;
+        for (size_t i = Bucket(hash); mBuckets[i] != NoSlot; i = (i + 1) & mask)
+        {
+            DnssdSlot slot = mBuckets[i];
+            if (mHashes[slot] == hash && SameString(RecordAt(slot)->mId, id))
+            {
+                return RecordAt(slot);
+            }
+        }
+        return nullptr;
+    }
+
+    DnssdServiceInstance* DnssdServiceTable::Insert(Platform::String^ id)
+    {
+        if ((mCount + 1) * 2 > mBuckets.size())
+        {
+            Grow();
+        }
+
+        DnssdSlot slot;
+        if (!mFree.empty())
+        {
+            slot = mFree.back();
+            mFree.pop_back();
+        }
+        else
+        {
+            slot = End();
+            if (slot % ChunkSize == 0)
+            {
+                mChunks.push_back(std::unique_ptr<DnssdServiceInstance[]>(new DnssdServiceInstance[ChunkSize]));
+            }
+            mHashes.push_back(0);
+            mStates.push_back(0);
+            mTypes.push_back(0);
+            mNextProbe.push_back(TimePoint());
+            mLastSeen.push_back(TimePoint());
+        }
+
+        unsigned int hash = DnssdHashString(id->Data(), id->Length());
+        mHashes[slot] = hash;
+        mStates[slot] = Live;
+        mTypes[slot] = static_cast<unsigned char>(DnssdServiceUpdateType::ServiceAdded);
+        mNextProbe[slot] = TimePoint();
+        mLastSeen[slot] = TimePoint();
+
+        size_t mask = mBuckets.size() - 1;
+        size_t i = Bucket(hash);
+        while (mBuckets[i] != NoSlot)
+        {
+            i = (i + 1) & mask;
+        }
+        mBuckets[i] = slot;
+
+        DnssdServiceInstance* info = RecordAt(slot);
+        info->mId = id;
+        info->mSlot = slot;
+        mIdBytes += StringBytes(id);
+        ++mCount;
+        return info;
+    }
+
+    void DnssdServiceTable::Erase(DnssdServiceInstance* info)
+    {
+        DnssdSlot slot = info->mSlot;
+        size_t mask = mBuckets.size() - 1;
+        size_t i = Bucket(mHashes[slot]);
+        while (mBuckets[i] != slot)
+        {
+            i = (i + 1) & mask;
+        }
+
+        // backward shift deletion. Entries after the hole move into it unless that would put
+        // them before their home bucket, so no probe sequence is broken and no tombstones are left
+        size_t j = i;
+        for (;;)
+        {
+            j = (j + 1) & mask;
+            if (mBuckets[j] == NoSlot)
+            {
+                break;
+            }
+
+            size_t home = Bucket(mHashes[mBuckets[j]]);
+            bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays)
+            {
+                mBuckets[i] = mBuckets[j];
+                i = j;
+            }
+        }
+        mBuckets[i] = NoSlot;
+
+        mStrings.Release(info->mHost);
+        mStrings.Release(info->mPort);
+        mStrings.Release(info->mInstanceName);
+        mIdBytes -= StringBytes(info->mId);
+
+        // release anything the record holds before the slot is reused
+        *info = DnssdServiceInstance();
+        mStates[slot] = 0;
+        mFree.push_back(slot);
+        --mCount;
+    }
+
+    void DnssdServiceTable::Assign(Platform::String^& field, Platform::String^ value)
+    {
+        // intern first so a field set to its own value is not dropped from the pool
+        Platform::String^ pooled = mStrings.Intern(value);
+        mStrings.Release(field);
+        field = pooled;
+    }
+
+    void DnssdServiceTable::Grow()
+    {
+        mBucketBits = mBuckets.empty() ? InitialBucketBits : mBucketBits + 1;
+        mBuckets.assign(static_cast<size_t>(1) << mBucketBits, static_cast<DnssdSlot>(NoSlot));
+
+        size_t mask = mBuckets.size() - 1;
+        for (DnssdSlot slot = 0; slot < End(); ++slot)
+        {
+            if (mStates[slot] & Live)
+            {
+                size_t i = Bucket(mHashes[slot]);
+                while (mBuckets[i] != NoSlot)
+                {
+                    i = (i + 1) & mask;
+                }
+                mBuckets[i] = slot;
+            }
+        }
+    }
+
+    size_t DnssdServiceTable::MemoryBytes() const
+    {
+        size_t bytes = sizeof(*this);
+        bytes += mHashes.capacity() * sizeof(unsigned int) + mStates.capacity() + mTypes.capacity();
+        bytes += (mNextProbe.capacity() + mLastSeen.capacity()) * sizeof(TimePoint);
+        bytes += mChunks.size() * ChunkSize * sizeof(DnssdServiceInstance) + mChunks.capacity() * sizeof(mChunks[0]);
+        bytes += (mFree.capacity() + mBuckets.capacity()) * sizeof(DnssdSlot);
+        bytes += mIdBytes + mStrings.MemoryBytes();
+        return bytes;
+    }
+}
@@ -0,0 +1,205 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "dnssd.h"
+#include "DnssdClock.h"
+#include "DnssdScheduler.h"
+
+namespace dnssd_uwp
+{
+    typedef unsigned int DnssdSlot;
+
+    // FNV-1a over UTF-16 characters
+    inline unsigned int DnssdHashString(const wchar_t* s, unsigned int length)
+    {
+        unsigned int hash = 2166136261u;
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            hash = (hash ^ s[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    // value hash and equality of Platform::String keys
+    struct DnssdStringHash
+    {
+        size_t operator()(Platform::String^ s) const { return DnssdHashString(s->Data(), s->Length()); }
+    };
+
+    struct DnssdStringEqual
+    {
+        bool operator()(Platform::String^ a, Platform::String^ b) const
+        {
+            return a->Length() == b->Length() && wmemcmp(a->Data(), b->Data(), a->Length()) == 0;
+        }
+    };
+
+    // Deduplicating pool for the strings of a service table. Equal strings share one
+    // Platform::String, which matters for the host addresses and ports most services
+    // have in common. Counts its users so a string leaves once the last one releases it.
+    class DnssdStringPool
+    {
+    public:
+        DnssdStringPool();
+
+        // the pooled string equal to s. nullptr stays nullptr
+        Platform::String^ Intern(Platform::String^ s);
+        void Release(Platform::String^ s);
+
+        // approximate heap use of the pooled strings and the pool itself
+        size_t MemoryBytes() const;
+
+    private:
+        std::unordered_map<Platform::String^, unsigned int, DnssdStringHash, DnssdStringEqual> mStrings;
+        size_t mCharacterBytes;
+    };
+
+    // service record tracked by a watcher. Holds the fields that are only read when the
+    // service itself changes or is reported; the fields every scan reads are kept by the
+    // table in dense arrays indexed by mSlot
+    struct DnssdServiceInstance
+    {
+        DnssdServiceInstance()
+            : mDebounceTimer(0)
+            , mPriority(0)
+            , mWeight(0)
+            , mProbeFailures(0)
+            , mCacheExpires(0)
+            , mSlot(0)
+        {
+        }
+
+        // host, port and instance name are pooled. Set them with DnssdServiceTable::Assign
+        Platform::String^ mHost;
+        Platform::String^ mPort;
+        Platform::String^ mInstanceName;
+        Platform::String^ mId;
+
+        // last state delivered to the client. Used to drop debounced changes that end where they started
+        Platform::String^ mReportedHost;
+        Platform::String^ mReportedPort;
+        Platform::String^ mReportedInstanceName;
+
+        // pending debounce window for this service on the shared scheduler. 0 if none
+        DnssdTimerId mDebounceTimer;
+
+        // SRV priority and weight used by dnssd_pick_instance()
+        unsigned short mPriority;
+        unsigned short mWeight;
+
+        // consecutive failed liveness probes
+        unsigned int mProbeFailures;
+
+        // expiry of a service restored from the warm-start cache
+        unsigned long long mCacheExpires;
+
+        DnssdSlot mSlot;
+    };
+
+    // Service table of one shard, laid out as parallel arrays indexed by slot.
+    // The sweep at the end of a scan and the probe tick walk the state and deadline
+    // arrays without touching the records, and lookups by id go through an open
+    // addressing index that compares the stored hashes before any string.
+    // Freed slots are reused before the table grows. Not thread safe.
+    class DnssdServiceTable
+    {
+    public:
+        typedef DnssdClock::TimePoint TimePoint;
+
+        // state bits of a slot
+        enum StateFlags
+        {
+            Live = 0x01,                            // slot holds a service
+            Changed = 0x02,                         // changed since the last scan
+            Provisional = 0x04,                     // restored from the warm-start cache and not yet seen by a scan
+            Probing = 0x08,                         // a liveness probe is in flight
+            Unhealthy = 0x10                        // liveness probes failed
+        };
+
+        DnssdServiceTable();
+
+        DnssdServiceInstance* Find(Platform::String^ id);
+
+        // add a service with the id. It must not be in the table
+        DnssdServiceInstance* Insert(Platform::String^ id);
+
+        void Erase(DnssdServiceInstance* info);
+
+        // replace a pooled string field of a record
+        void Assign(Platform::String^& field, Platform::String^ value);
+
+        // slots are iterated from 0 to End(). Record() is nullptr for a free slot
+        DnssdSlot End() const { return static_cast<DnssdSlot>(mStates.size()); }
+        DnssdServiceInstance* Record(DnssdSlot slot) { return (mStates[slot] & Live) ? RecordAt(slot) : nullptr; }
+
+        bool Empty() const { return mCount == 0; }
+        size_t Size() const { return mCount; }
+
+        // number of records the table has room for. Stays flat under steady churn
+        size_t Capacity() const { return mChunks.size() * ChunkSize; }
+
+        // approximate heap use of the whole table, strings included
+        size_t MemoryBytes() const;
+
+        DnssdServiceUpdateType Type(DnssdSlot slot) const { return static_cast<DnssdServiceUpdateType>(mTypes[slot]); }
+        void SetType(DnssdSlot slot, DnssdServiceUpdateType type) { mTypes[slot] = static_cast<unsigned char>(type); }
+
+        bool Test(DnssdSlot slot, StateFlags flag) const { return (mStates[slot] & flag) != 0; }
+        void Set(DnssdSlot slot, StateFlags flag, bool on)
+        {
+            mStates[slot] = static_cast<unsigned char>(on ? mStates[slot] | flag : mStates[slot] & ~flag);
+        }
+
+        // when the service is next due for a liveness probe
+        TimePoint& NextProbe(DnssdSlot slot) { return mNextProbe[slot]; }
+
+        // last backend event for the service. Taken as the departure time when a scan no longer finds it
+        TimePoint& LastSeen(DnssdSlot slot) { return mLastSeen[slot]; }
+
+    private:
+        static const DnssdSlot NoSlot = 0xffffffff;
+        static const size_t ChunkSize = 64;
+
+        DnssdServiceTable(const DnssdServiceTable&) = delete;
+        DnssdServiceTable& operator=(const DnssdServiceTable&) = delete;
+
+        DnssdServiceInstance* RecordAt(DnssdSlot slot) { return &mChunks[slot / ChunkSize][slot % ChunkSize]; }
+        size_t Bucket(unsigned int hash) const;
+        void Grow();
+
+        // hot fields, one entry per slot
+        std::vector<unsigned int> mHashes;
+        std::vector<unsigned char> mStates;
+        std::vector<unsigned char> mTypes;
+        std::vector<TimePoint> mNextProbe;
+        std::vector<TimePoint> mLastSeen;
+
+        // records in chunks that are never moved, so record pointers stay valid until the slot is freed
+        std::vector<std::unique_ptr<DnssdServiceInstance[]>> mChunks;
+        std::vector<DnssdSlot> mFree;
+
+        // id index. Linear probing over a power of two number of buckets holding slots
+        std::vector<DnssdSlot> mBuckets;
+        unsigned int mBucketBits;
+
+        size_t mCount;
+        size_t mIdBytes;
+        DnssdStringPool mStrings;
+    };
+};
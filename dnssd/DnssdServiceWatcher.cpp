@@ -12,6 +12,8 @@
 
 #include "DnssdServiceWatcher.h"
 #include "DnssdUtils.h"
+#include "DnssdProperties.h"
+#include "DnssdClock.h"
 #include <algorithm>
 #include <vector>
 #include <collection.h>
@@ -32,25 +34,301 @@ using namespace concurrency;
 
 namespace dnssd_uwp
 {
+    // how long a saved service may be restored when the options do not say
+    static const unsigned int DefaultCacheTtlSeconds = 120;
 
-    DnssdServiceWatcher::DnssdServiceWatcher(const char* serviceName, DnssdServiceChangedCallback callback)
+    // unicast browse interval when the domain has no usable SOA record
+    static const unsigned int DefaultPollSeconds = 60;
+
+    // more shards than pool threads only adds queues
+    static const unsigned int MaxShards = 64;
+
+    // picks retried when the picked instance leaves before it is read
+    static const unsigned int MaxPickAttempts = 4;
+
+    // liveness probing defaults. A single failed connect is retried at once before the service is marked unhealthy
+    static const unsigned int DefaultProbeTimeoutMilliseconds = 2000;
+    static const unsigned int DefaultProbesPerSecond = 20;
+    static const unsigned int ProbeTickMilliseconds = 1000;
+    static const unsigned int UnhealthyProbeFailures = 2;
+
+    // the DeviceWatcher properties that carry the DnssdServiceFields in fields
+    static unsigned int FieldPropertyMask(unsigned int fields)
+    {
+        unsigned int mask = 0;
+        if (fields & DNSSD_FIELD_INSTANCE_NAME)
+        {
+            mask |= DNSSD_PROPERTY_BIT(DnssdPropertyInstanceName);
+        }
+        if (fields & DNSSD_FIELD_HOST)
+        {
+            mask |= DNSSD_PROPERTY_BIT(DnssdPropertyHostName) | DNSSD_PROPERTY_BIT(DnssdPropertyIpAddress);
+        }
+        if (fields & DNSSD_FIELD_PORT)
+        {
+            mask |= DNSSD_PROPERTY_BIT(DnssdPropertyPortNumber) | DNSSD_PROPERTY_BIT(DnssdPropertyPriority) | DNSSD_PROPERTY_BIT(DnssdPropertyWeight);
+        }
+        return mask;
+    }
+
+    // the properties a host is picked from. Without a host filter it is the first address
+    static const unsigned int HostPropertyMask = DNSSD_PROPERTY_BIT(DnssdPropertyHostName) | DNSSD_PROPERTY_BIT(DnssdPropertyIpAddress);
+
+    static Platform::String^ FirstAddress(Platform::Array<Platform::String^>^ addresses)
+    {
+        return addresses != nullptr && addresses->Length > 0 ? addresses->get(0) : nullptr;
+    }
+
+    static unsigned short PropertyToUInt16(Platform::String^ s)
+    {
+        int value = s != nullptr ? _wtoi(s->Data()) : 0;
+        return static_cast<unsigned short>(value < 0 ? 0 : value > 65535 ? 65535 : value);
+    }
+
+    DnssdServiceWatcher::DnssdServiceWatcher(const char* serviceName, const DnssdServiceWatcherOptions& options, DnssdServiceChangedCallback callback)
         : mDnssdServiceChangedCallback(callback)
+        , mDnssdServiceChangedContextCallback(nullptr)
+        , mContext(nullptr)
+        , mHandle(nullptr)
+        , mTypeEnumeration(false)
+        , mPollSeconds(0)
+        , mPollTimer(0)
+        , mProbeTimer(0)
+        , mOptions(options)
+        , mPropertyMask(DnssdDefaultPropertyMask)
+        , mFieldMask(DNSSD_FIELD_ALL)
         , mRunning(false)
     {
+        mStats = DnssdServiceWatcherStats();
         mServiceName = StringToPlatformString(serviceName);
+
+        std::string name(serviceName);
+        mTypeEnumeration = name == DNSSD_SERVICE_TYPE_ENUMERATION || name == DNSSD_SERVICE_TYPE_ENUMERATION ".local";
     }
 
     DnssdServiceWatcher::~DnssdServiceWatcher()
     {
+        Stop();
+    }
+
+    void DnssdServiceWatcher::Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            StopServiceWatcher();
+        }
+
+        // outside the lock as a callback in progress may call back into the watcher
+        for (auto it = mShards.begin(); it != mShards.end(); ++it)
+        {
+            if ((*it)->mQueue)
+            {
+                (*it)->mQueue->Shutdown();
+            }
+        }
+        ClearDnssdServices();
+
+        if (mExecutor)
+        {
+            mExecutor->Shutdown();
+        }
+    }
+
+    void DnssdServiceWatcher::StopServiceWatcher()
+    {
+        if (mRunning)
+        {
+            SaveServiceCache();
+        }
+        mRunning = false;
+
+        if (mPollTimer != 0)
+        {
+            DnssdScheduler::Instance().Cancel(mPollTimer);
+            mPollTimer = 0;
+        }
+
+        if (mProbeTimer != 0)
+        {
+            DnssdScheduler::Instance().Cancel(mProbeTimer);
+            mProbeTimer = 0;
+        }
+
         if (mServiceWatcher)
         {
-            mRunning = false;
-            mServiceWatcher->Stop();
+            // the handlers hold a reference to this watcher. Unregister them so it can be released
+            mServiceWatcher->Added -= mAddedToken;
+            mServiceWatcher->Removed -= mRemovedToken;
+            mServiceWatcher->Updated -= mUpdatedToken;
+            mServiceWatcher->EnumerationCompleted -= mEnumerationCompletedToken;
+            mServiceWatcher->Stopped -= mStoppedToken;
+
+            auto status = mServiceWatcher->Status;
+            if (status == DeviceWatcherStatus::Started || status == DeviceWatcherStatus::EnumerationCompleted)
+            {
+                mServiceWatcher->Stop();
+            }
             mServiceWatcher = nullptr;
         }
     }
 
+    void DnssdServiceWatcher::ClearDnssdServices()
+    {
+        for (auto it = mShards.begin(); it != mShards.end(); ++it)
+        {
+            DnssdServiceShard& shard = **it;
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            shard.mFilterStates.clear();
+            for (DnssdSlot slot = 0; slot < shard.mServices.End(); ++slot)
+            {
+                DnssdServiceInstance* info = shard.mServices.Record(slot);
+                if (info != nullptr)
+                {
+                    EraseDnssdService(shard, info);
+                }
+            }
+        }
+    }
+
     DnssdErrorType DnssdServiceWatcher::Initialize()
+    {
+        // compile the watcher filters once. The option strings belong to the caller and are not kept
+        DnssdErrorType result = mFilter.Compile(mOptions);
+        mOptions.instanceNameFilter = nullptr;
+        mOptions.hostFilter = nullptr;
+        mOptions.txtKeyFilter = nullptr;
+        if (result != DNSSD_NO_ERROR)
+        {
+            return result;
+        }
+
+        // the type registry has no host or TXT record of its own to match
+        if (mTypeEnumeration && (mFilter.HasHostFilter() || mFilter.HasTxtKeyFilter()))
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        if (mOptions.cachePath != nullptr)
+        {
+            mCache.reset(new DnssdServiceCache(Utf8ToWideString(mOptions.cachePath), mServiceName->Data()));
+            mOptions.cachePath = nullptr;
+        }
+
+        if (mOptions.cacheTtlSeconds == 0)
+        {
+            mOptions.cacheTtlSeconds = DefaultCacheTtlSeconds;
+        }
+
+        if (mOptions.probeTimeoutMilliseconds == 0)
+        {
+            mOptions.probeTimeoutMilliseconds = DefaultProbeTimeoutMilliseconds;
+        }
+
+        if (mOptions.probesPerSecond == 0)
+        {
+            mOptions.probesPerSecond = DefaultProbesPerSecond;
+        }
+
+        if (mOptions.domain != nullptr && *mOptions.domain != 0 && _stricmp(mOptions.domain, "local") != 0 && _stricmp(mOptions.domain, "local.") != 0)
+        {
+            mUnicastBrowser.reset(new DnssdUnicastBrowser(mServiceName->Data(), Utf8ToWideString(mOptions.domain)));
+            result = mUnicastBrowser->Initialize(mOptions.unicastServer);
+        }
+        mOptions.domain = nullptr;
+        mOptions.unicastServer = nullptr;
+        if (result != DNSSD_NO_ERROR)
+        {
+            return result;
+        }
+
+        // probes connect to host:port, so probing tracks both whatever the mask says
+        mFieldMask = mOptions.fieldMask == 0 ? DNSSD_FIELD_ALL : (mOptions.fieldMask & DNSSD_FIELD_ALL) | DNSSD_FIELD_ID;
+        if (mOptions.probeIntervalSeconds > 0)
+        {
+            mFieldMask |= DNSSD_FIELD_HOST | DNSSD_FIELD_PORT;
+        }
+
+        // only the properties of the tracked fields and the filters are requested and decoded.
+        // The type registry reports types, which come from the service name
+        mPropertyMask = mTypeEnumeration ? DnssdDefaultPropertyMask : FieldPropertyMask(mFieldMask);
+        if (mFilter.HasInstanceNameFilter())
+        {
+            mPropertyMask |= DNSSD_PROPERTY_BIT(DnssdPropertyInstanceName);
+        }
+        if (mFilter.HasHostFilter())
+        {
+            mPropertyMask |= DNSSD_PROPERTY_BIT(DnssdPropertyHostName) | DNSSD_PROPERTY_BIT(DnssdPropertyIpAddress);
+        }
+        if (mFilter.HasTxtKeyFilter())
+        {
+            mPropertyMask |= DNSSD_PROPERTY_BIT(DnssdPropertyTextAttributes);
+        }
+
+        // the type registry is keyed by type, which is only known once a change is decoded. It is never sharded
+        unsigned int shardCount = mTypeEnumeration || mOptions.shardCount == 0 ? 1 : mOptions.shardCount;
+        if (shardCount > MaxShards)
+        {
+            shardCount = MaxShards;
+        }
+
+        for (unsigned int i = 0; i < shardCount; ++i)
+        {
+            std::unique_ptr<DnssdServiceShard> shard(new DnssdServiceShard());
+            shard->mStats = DnssdServiceWatcherStats();
+            shard->mScan = 0;
+            if (shardCount > 1)
+            {
+                shard->mQueue.reset(new DnssdWorkQueue());
+            }
+            mShards.push_back(std::move(shard));
+        }
+
+        WeakReference weakThis(this);
+        mExecutor = DnssdExecutor::Create(mOptions.executor, [weakThis](const DnssdServiceEvent& event)
+        {
+            auto watcher = weakThis.Resolve<DnssdServiceWatcher>();
+            if (watcher != nullptr)
+            {
+                watcher->DeliverDnssdServiceEvent(event);
+            }
+        });
+
+        mStartTime = DnssdClock::Current().Now();
+
+        if (mUnicastBrowser)
+        {
+            // wide-area browsing polls the unicast server instead of running a DeviceWatcher
+            mRunning = true;
+            ScheduleUnicastPoll(0);
+            ScheduleProbe(ProbeTickMilliseconds);
+        }
+        else
+        {
+            result = StartDeviceWatcher();
+            if (result != DNSSD_NO_ERROR)
+            {
+                return result;
+            }
+        }
+
+        if (mCache)
+        {
+            // the services saved at the last shutdown are only reported once the watcher runs. A service the
+            // first scan has already found is not restored
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (mRunning)
+                {
+                    LoadServiceCache();
+                }
+            }
+            FlushDnssdServiceEvents();
+        }
+
+        return DNSSD_NO_ERROR;
+    }
+
+    DnssdErrorType DnssdServiceWatcher::StartDeviceWatcher()
     {
         auto task = create_task(create_async([this]
         {
@@ -58,29 +336,31 @@ namespace dnssd_uwp
             /// All of the properties that will be returned when a DNS-SD instance has been found. 
             /// </summary>
 
-            Vector<Platform::String^>^ propertyKeys = ref new Vector<Platform::String^>();
-            propertyKeys->Append(L"System.Devices.Dnssd.HostName");
-            propertyKeys->Append(L"System.Devices.Dnssd.ServiceName");
-            propertyKeys->Append(L"System.Devices.Dnssd.InstanceName");
-            propertyKeys->Append(L"System.Devices.IpAddress");
-            propertyKeys->Append(L"System.Devices.Dnssd.PortNumber");
+            Vector<Platform::String^>^ propertyKeys = DnssdPropertyKeys(mPropertyMask);
 
             Platform::String^ aqsQueryString;
             aqsQueryString = L"System.Devices.AepService.ProtocolId:={4526e8c1-8aac-4153-9b16-55e86ada0e54} AND " +
-                "System.Devices.Dnssd.Domain:=\"local\" AND System.Devices.Dnssd.ServiceName:=\"" + mServiceName + "\"";
+                "System.Devices.Dnssd.Domain:=\"local\"";
+
+            // the type enumeration browses every instance on the network and reports their types
+            if (!mTypeEnumeration)
+            {
+                aqsQueryString += " AND System.Devices.Dnssd.ServiceName:=\"" + mServiceName + "\"";
+            }
 
             mServiceWatcher = DeviceInformation::CreateWatcher(aqsQueryString, propertyKeys, DeviceInformationKind::AssociationEndpointService);
 
             // wire up event handlers
-            mServiceWatcher->Added += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformation ^>(this, &DnssdServiceWatcher::OnServiceAdded);
-            mServiceWatcher->Removed += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformationUpdate ^>(this, &DnssdServiceWatcher::OnServiceRemoved);
-            mServiceWatcher->Updated += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformationUpdate ^>(this, &DnssdServiceWatcher::OnServiceUpdated);
-            mServiceWatcher->EnumerationCompleted += ref new Windows::Foundation::TypedEventHandler<DeviceWatcher ^, Platform::Object ^>(this, &DnssdServiceWatcher::OnServiceEnumerationCompleted);
-            mServiceWatcher->Stopped += ref new Windows::Foundation::TypedEventHandler<DeviceWatcher ^, Platform::Object ^>(this, &DnssdServiceWatcher::OnServiceEnumerationStopped);
+            mAddedToken = mServiceWatcher->Added += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformation ^>(this, &DnssdServiceWatcher::OnServiceAdded);
+            mRemovedToken = mServiceWatcher->Removed += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformationUpdate ^>(this, &DnssdServiceWatcher::OnServiceRemoved);
+            mUpdatedToken = mServiceWatcher->Updated += ref new TypedEventHandler<DeviceWatcher ^, DeviceInformationUpdate ^>(this, &DnssdServiceWatcher::OnServiceUpdated);
+            mEnumerationCompletedToken = mServiceWatcher->EnumerationCompleted += ref new Windows::Foundation::TypedEventHandler<DeviceWatcher ^, Platform::Object ^>(this, &DnssdServiceWatcher::OnServiceEnumerationCompleted);
+            mStoppedToken = mServiceWatcher->Stopped += ref new Windows::Foundation::TypedEventHandler<DeviceWatcher ^, Platform::Object ^>(this, &DnssdServiceWatcher::OnServiceEnumerationStopped);
 
-            // start watching for dnssd services
-            mServiceWatcher->Start();
+            // start watching for dnssd services. Events are dropped until mRunning is set
             mRunning = true;
+            ScheduleProbe(ProbeTickMilliseconds);
+            mServiceWatcher->Start();
             auto status = mServiceWatcher->Status;
         }));
 
@@ -92,146 +372,1131 @@ namespace dnssd_uwp
         }
         catch (Platform::Exception^ ex)
         {
+            // nothing ran, so Stop must not overwrite the saved cache with the empty table
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunning = false;
             return DNSSD_SERVICEWATCHER_INITIALIZATION_ERROR;
         }
     }
 
-    void DnssdServiceWatcher::UpdateDnssdService(DnssdServiceUpdateType type, Windows::Foundation::Collections::IMapView<Platform::String^, Platform::Object^>^ props, Platform::String^ serviceId)
+    void DnssdServiceWatcher::UpdateDnssdService(DnssdServiceShard& shard, DnssdServiceUpdateType type, const DnssdServiceRecord& record, Platform::String^ serviceId)
     {
-        auto box = safe_cast<Platform::IBoxArray<Platform::String^>^>(props->Lookup("System.Devices.IpAddress"));
-        Platform::String^ host = box->Value->get(0);
-        Platform::String^ port = props->Lookup("System.Devices.Dnssd.PortNumber")->ToString();
-        Platform::String^ name = props->Lookup("System.Devices.Dnssd.InstanceName")->ToString();
+        ++shard.mStats.backendEvents;
+
+        // an Added event carries every requested property, an Updated event only the ones that changed
+        unsigned int present = type == DnssdServiceUpdateType::ServiceAdded ? mPropertyMask : record.present;
+        const DnssdServiceRecord* values = &record;
+        Platform::String^ host = nullptr;
 
-        auto it = mServices.find(serviceId);
-        if (it != mServices.end()) // service was previously found. Update the info and report change if necessary
+        if (!FilterDnssdService(shard, serviceId, present, values, host))
         {
-            auto info = it->second;
+            ++shard.mStats.filteredEvents;
+
+            // a service that no longer passes the filters leaves the client's view
+            DnssdServiceInstance* info = shard.mServices.Find(serviceId);
+            if (info != nullptr)
+            {
+                RemoveDnssdService(shard, info, DnssdClock::Current().Now());
+                EraseDnssdService(shard, info);
+            }
+            return;
+        }
+
+        // fields outside the mask stay nullptr, so they never compare as changed
+        Platform::String^ name = TrackedField(DNSSD_FIELD_INSTANCE_NAME, values->instanceName);
+        Platform::String^ port = TrackedField(DNSSD_FIELD_PORT, values->port);
+        host = TrackedField(DNSSD_FIELD_HOST, host);
+
+        DnssdServiceTable& services = shard.mServices;
+        DnssdServiceInstance* info = services.Find(serviceId);
+        if (info != nullptr) // service was previously found. Update the info and report change if necessary
+        {
+            DnssdSlot slot = info->mSlot;
+
+            // a field the event does not carry keeps its value
+            if (!(present & DNSSD_PROPERTY_BIT(DnssdPropertyInstanceName)))
+            {
+                name = info->mInstanceName;
+            }
+            if (!(present & DNSSD_PROPERTY_BIT(DnssdPropertyPortNumber)))
+            {
+                port = info->mPort;
+            }
+            if (!(present & (mFilter.HasHostFilter() ? HostPropertyMask : DNSSD_PROPERTY_BIT(DnssdPropertyIpAddress))))
+            {
+                host = info->mHost;
+            }
+
+            // a restored service seen by a scan is confirmed. Report that at once, outside any debounce window
+            bool confirmed = services.Test(slot, DnssdServiceTable::Provisional);
+            services.Set(slot, DnssdServiceTable::Provisional, false);
+            services.LastSeen(slot) = DnssdClock::Current().Now();
+
+            if (info->mHost != host || info->mPort != port)
+            {
+                // a moved service is probed at its new endpoint on the next tick
+                services.NextProbe(slot) = DnssdClock::Current().Now();
+            }
             if (info->mHost != host)
             {
-                info->mHost = host;
-                info->mChanged = true;
+                services.Assign(info->mHost, host);
+                services.Set(slot, DnssdServiceTable::Changed, true);
             }
             if (info->mPort != port)
             {
-                info->mPort = port;
-                info->mChanged = true;
+                services.Assign(info->mPort, port);
+                services.Set(slot, DnssdServiceTable::Changed, true);
             }
             if (info->mInstanceName != name)
             {
-                info->mInstanceName = name;
-                info->mChanged = true;
+                services.Assign(info->mInstanceName, name);
+                services.Set(slot, DnssdServiceTable::Changed, true);
+            }
+            services.SetType(slot, DnssdServiceUpdateType::ServiceUpdated);
+
+            // updates only carry the SRV values when they change
+            if (present & DNSSD_PROPERTY_BIT(DnssdPropertyPriority))
+            {
+                info->mPriority = PropertyToUInt16(values->priority);
+            }
+            if (present & DNSSD_PROPERTY_BIT(DnssdPropertyWeight))
+            {
+                info->mWeight = PropertyToUInt16(values->weight);
+            }
+            if (!services.Test(slot, DnssdServiceTable::Unhealthy))
+            {
+                mPicker.Update(std::wstring(serviceId->Data(), serviceId->Length()), info->mPriority, info->mWeight);
             }
-            info->mType = DnssdServiceUpdateType::ServiceUpdated;
 
-            if (info->mChanged)
+            if (confirmed)
+            {
+                CancelDebounceTimer(info);
+                OnDnssdServiceUpdated(shard, info, services.Type(slot));
+            }
+            else if (services.Test(slot, DnssdServiceTable::Changed))
             {
-                // report the updated service
-                OnDnssdServiceUpdated(info);
+                if (mOptions.debounceMilliseconds > 0)
+                {
+                    // merge this change with any others that arrive before the debounce window closes
+                    StartDebounceTimer(shard, info);
+                }
+                else
+                {
+                    // report the updated service
+                    OnDnssdServiceUpdated(shard, info, services.Type(slot));
+                }
             }
         }
-        else // add it to the service map
+        else // add it to the service table
         {
-            DnssdServiceInstance^ info = ref new DnssdServiceInstance;
-            info->mId = serviceId;
-            info->mHost = host;
-            info->mPort = port;
-            info->mInstanceName = name;
-            info->mType = DnssdServiceUpdateType::ServiceAdded;
-            mServices[serviceId] = info;
+            info = services.Insert(serviceId);
+            services.Assign(info->mHost, host);
+            services.Assign(info->mPort, port);
+            services.Assign(info->mInstanceName, name);
+            services.LastSeen(info->mSlot) = DnssdClock::Current().Now();
+            info->mPriority = PropertyToUInt16(values->priority);
+            info->mWeight = PropertyToUInt16(values->weight);
+            shard.mStats.instanceSlots = static_cast<unsigned int>(services.Capacity());
+            mPicker.Update(std::wstring(serviceId->Data(), serviceId->Length()), info->mPriority, info->mWeight);
 
             // report the new service
-            OnDnssdServiceUpdated(info);
+            OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceAdded);
         }
     }
 
-    void DnssdServiceWatcher::OnDnssdServiceUpdated(DnssdServiceInstance^ info)
+    void DnssdServiceWatcher::UpdateDnssdServiceType(DnssdServiceShard& shard, const DnssdServiceRecord& record)
     {
-        DnssdServiceWatcherWrapper wrapper(this);
-        DnssdServiceInfo serviceInfo;
+        ++shard.mStats.backendEvents;
+
+        // updates only carry the properties that changed. Without the type they say nothing about the registry
+        Platform::String^ serviceType = record.serviceName;
+        if (serviceType == nullptr || serviceType->IsEmpty())
+        {
+            return;
+        }
+
+        if (!mFilter.MatchInstanceName(serviceType->Data()))
+        {
+            ++shard.mStats.filteredEvents;
+            return;
+        }
+
+        DnssdServiceTable& services = shard.mServices;
+        DnssdServiceInstance* info = services.Find(serviceType);
+        if (info != nullptr)
+        {
+            // another instance of a known type keeps the type alive for this scan
+            DnssdSlot slot = info->mSlot;
+            services.SetType(slot, DnssdServiceUpdateType::ServiceUpdated);
+            services.LastSeen(slot) = DnssdClock::Current().Now();
+            if (services.Test(slot, DnssdServiceTable::Provisional))
+            {
+                services.Set(slot, DnssdServiceTable::Provisional, false);
+                OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceUpdated);
+            }
+            return;
+        }
 
-        // convert Platform::Strings to std::strings 
-        std::string host = PlatformStringToString(info->mHost);
-        std::string  port = PlatformStringToString(info->mPort);
-        std::string instanceName = PlatformStringToString(info->mInstanceName);
-        std::string id = PlatformStringToString(info->mId);
+        info = services.Insert(serviceType);
+        services.Assign(info->mInstanceName, serviceType);
+        services.LastSeen(info->mSlot) = DnssdClock::Current().Now();
+        shard.mStats.instanceSlots = static_cast<unsigned int>(services.Capacity());
 
-        serviceInfo.host = host.c_str();
-        serviceInfo.port = port.c_str();
-        serviceInfo.id = id.c_str();
-        //serviceInfo.instanceName = instanceName.c_str();
-        serviceInfo.instanceName = instanceName.c_str();
+        OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceAdded);
+    }
 
-        auto foo = info->mId->Data();
+    void DnssdServiceWatcher::GetStats(DnssdServiceWatcherStats& stats)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        stats = mStats;
 
-        if (mDnssdServiceChangedCallback != nullptr)
+        // add up the shards. The latest removal is the latest one of any shard
+        std::chrono::steady_clock::time_point lastRemoval;
+        for (auto it = mShards.begin(); it != mShards.end(); ++it)
         {
-            mDnssdServiceChangedCallback(&wrapper, info->mType, &serviceInfo);
+            DnssdServiceShard& shard = **it;
+            std::lock_guard<std::mutex> shardLock(shard.mMutex);
+            const DnssdServiceWatcherStats& s = shard.mStats;
+
+            if (s.firstResultMilliseconds != 0 && (stats.firstResultMilliseconds == 0 || s.firstResultMilliseconds < stats.firstResultMilliseconds))
+            {
+                stats.firstResultMilliseconds = s.firstResultMilliseconds;
+            }
+            stats.backendEvents += s.backendEvents;
+            stats.filteredEvents += s.filteredEvents;
+            stats.mergedEvents += s.mergedEvents;
+            stats.callbacks += s.callbacks;
+            stats.instanceSlots += s.instanceSlots;
+            stats.services += static_cast<unsigned int>(shard.mServices.Size());
+            stats.tableBytes += static_cast<unsigned int>(shard.mServices.MemoryBytes());
+            stats.cachedServices += s.cachedServices;
+            stats.removals += s.removals;
+            if (s.removals > 0 && shard.mLastRemoval >= lastRemoval)
+            {
+                lastRemoval = shard.mLastRemoval;
+                stats.lastRemovalMilliseconds = s.lastRemovalMilliseconds;
+            }
+            if (s.maxRemovalMilliseconds > stats.maxRemovalMilliseconds)
+            {
+                stats.maxRemovalMilliseconds = s.maxRemovalMilliseconds;
+            }
         }
     }
 
-    void DnssdServiceWatcher::OnServiceAdded(DeviceWatcher^ sender, DeviceInformation^ args)
+    unsigned int DnssdServiceWatcher::ShardIndex(Platform::String^ serviceId) const
     {
-        UpdateDnssdService(DnssdServiceUpdateType::ServiceAdded, args->Properties, args->Id);
+        if (mShards.size() == 1)
+        {
+            return 0;
+        }
+
+        return DnssdHashString(serviceId->Data(), serviceId->Length()) % mShards.size();
     }
 
-    void DnssdServiceWatcher::OnServiceUpdated(DeviceWatcher^ sender, DeviceInformationUpdate^ args)
+    void DnssdServiceWatcher::Dispatch(unsigned int shardIndex, const DnssdShardWork& work)
     {
-        UpdateDnssdService(DnssdServiceUpdateType::ServiceUpdated, args->Properties, args->Id);
+        // called with mMutex held while the watcher is running
+        DnssdServiceShard* shard = mShards[shardIndex].get();
+        if (!shard->mQueue)
+        {
+            std::lock_guard<std::mutex> lock(shard->mMutex);
+            work(*shard);
+            return;
+        }
+
+        // Stop shuts the queue down before the shard is released. A callback made by the flush may free
+        // the watcher, so the work item ends there. Stop does not wait for the item running on its own thread
+        shard->mQueue->Post([this, shard, work]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(shard->mMutex);
+                work(*shard);
+            }
+            FlushDnssdServiceEvents();
+        });
     }
 
-    void DnssdServiceWatcher::OnServiceRemoved(DeviceWatcher^ sender, DeviceInformationUpdate^ args)
+    void DnssdServiceWatcher::DispatchDnssdService(DnssdServiceUpdateType type, Platform::String^ serviceId, IMapView<Platform::String^, Platform::Object^>^ properties)
     {
-        UpdateDnssdService(DnssdServiceUpdateType::ServiceUpdated, args->Properties, args->Id);
+        // the type registry has a single shard
+        unsigned int shardIndex = ShardIndex(serviceId);
+        bool sharded = mShards[shardIndex]->mQueue != nullptr;
+
+        // decoding is most of the work for a change. A sharded watcher leaves it to the shard's queue,
+        // a single shard decodes before the lock is taken
+        DnssdServiceRecord record;
+        if (!sharded)
+        {
+            DecodeDnssdProperties(properties, mPropertyMask, record);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+            {
+                return;
+            }
+
+            Dispatch(shardIndex, [this, type, serviceId, properties, sharded, record](DnssdServiceShard& shard) mutable
+            {
+                if (sharded)
+                {
+                    DecodeDnssdProperties(properties, mPropertyMask, record);
+                }
+
+                if (mTypeEnumeration)
+                {
+                    UpdateDnssdServiceType(shard, record);
+                }
+                else
+                {
+                    UpdateDnssdService(shard, type, record, serviceId);
+                }
+            });
+        }
+        FlushDnssdServiceEvents();
     }
 
-    void DnssdServiceWatcher::OnServiceEnumerationCompleted(DeviceWatcher^ sender, Platform::Object^ args)
+    void* DnssdServiceWatcher::GetEventHandle()
     {
-        // stop the service scanning. Service scanning will be restarted when OnServiceEnumerationStopped event is received
-        mServiceWatcher->Stop();
+        return mExecutor ? mExecutor->GetEventHandle() : nullptr;
     }
 
-    void DnssdServiceWatcher::OnServiceEnumerationStopped(Windows::Devices::Enumeration::DeviceWatcher^ sender, Platform::Object^ args)
+    DnssdErrorType DnssdServiceWatcher::Poll(DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int& count)
     {
-        // check if we are shutting down
-        if (!mRunning)
+        // no watcher lock. The executor only locks its queue to take a batch
+        if (!mExecutor)
         {
-            return;
+            count = 0;
+            return DNSSD_INVALID_PARAMETER_ERROR;
         }
+        return mExecutor->Poll(events, eventSize, maxEvents, count);
+    }
 
-        std::vector<Platform::String^> removedServices;
-
-        // iterate through the services list and remove any service that is marked for removal
-        for (auto it = mServices.begin(); it != mServices.end(); ++it)
+    DnssdErrorType DnssdServiceWatcher::PickInstance(DnssdPickPolicy policy, DnssdServiceInfo& info)
+    {
+        for (unsigned int attempt = 0; attempt < MaxPickAttempts; ++attempt)
         {
-            auto service = it->second;
-            if (service->mType == DnssdServiceUpdateType::ServiceRemoved)
+            std::wstring id;
+            if (!mPicker.Pick(policy, id))
             {
-                // report to the client the removed service
-                OnDnssdServiceUpdated(service);
-                removedServices.push_back(it->first);
+                return DNSSD_NO_INSTANCE_ERROR;
             }
-            else // prepare the service for the next search
+
+            Platform::String^ serviceId = ref new Platform::String(id.c_str(), static_cast<unsigned int>(id.size()));
+            DnssdServiceShard& shard = *mShards[ShardIndex(serviceId)];
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+
+            // the instance left after it was picked. Pick again
+            DnssdServiceInstance* service = shard.mServices.Find(serviceId);
+            if (service == nullptr)
             {
-                // for each scan we mark each service as removed. 
-                // If the scan finds the service again we will update its state accordingly
-                service->mType = DnssdServiceUpdateType::ServiceRemoved;
-                service->mChanged = false;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> pickLock(mPickMutex);
+            mPickArena.Reset();
+            AppendPlatformString(mPickArena, service->mHost);
+            AppendPlatformString(mPickArena, service->mPort);
+            AppendPlatformString(mPickArena, service->mInstanceName);
+            AppendPlatformString(mPickArena, service->mId);
+
+            info.structSize = sizeof(DnssdServiceInfo);
+            info.host = mPickArena.String(0);
+            info.port = mPickArena.String(1);
+            info.instanceName = mPickArena.String(2);
+            info.id = mPickArena.String(3);
+            info.flags = 0;
+            info.changedFields = 0;
+            info.previousInstanceName = nullptr;
+            info.previousHost = nullptr;
+            info.previousPort = nullptr;
+            return DNSSD_NO_ERROR;
+        }
+
+        return DNSSD_NO_INSTANCE_ERROR;
+    }
+
+    static unsigned int MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        // never report 0 for a recorded interval as 0 means not recorded
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(DnssdClock::Current().Now() - start).count();
+        return elapsed > 0 ? static_cast<unsigned int>(elapsed) : 1;
+    }
+
+    bool DnssdServiceWatcher::FilterDnssdService(DnssdServiceShard& shard, Platform::String^ serviceId, unsigned int present, const DnssdServiceRecord*& record, Platform::String^& host)
+    {
+        if (!mFilter.HasFilters())
+        {
+            host = FirstAddress(record->addresses);
+            return true;
+        }
+
+        auto it = shard.mFilterStates.find(serviceId);
+        if (it == shard.mFilterStates.end())
+        {
+            // a service restored from the cache passed the filters before it was saved
+            DnssdFilterState state;
+            bool known = shard.mServices.Find(serviceId) != nullptr;
+            state.instanceNameMatch = known;
+            state.txtKeyMatch = known;
+            state.hostMatch = known;
+            it = shard.mFilterStates.insert(std::make_pair(serviceId, state)).first;
+        }
+
+        // the filters and the caller see every property the service has reported so far
+        DnssdFilterState& state = it->second;
+        state.scan = shard.mScan;
+        MergeDnssdProperties(state.record, *record, present);
+        record = &state.record;
+
+        // each filter runs again only when the event carries its properties. Everything here works on the raw property strings
+        if (mFilter.HasInstanceNameFilter() && (present & DNSSD_PROPERTY_BIT(DnssdPropertyInstanceName)))
+        {
+            state.instanceNameMatch = mFilter.MatchInstanceName(record->instanceName != nullptr ? record->instanceName->Data() : L"");
+        }
+
+        if (mFilter.HasTxtKeyFilter() && (present & DNSSD_PROPERTY_BIT(DnssdPropertyTextAttributes)))
+        {
+            bool found = false;
+            auto attributes = record->textAttributes;
+            for (unsigned int i = 0; attributes != nullptr && i < attributes->Length && !found; ++i)
+            {
+                found = mFilter.MatchTxtAttribute(attributes->get(i)->Data());
             }
+            state.txtKeyMatch = found;
         }
 
-        // remove stale services from the services map
-        std::for_each(begin(removedServices), end(removedServices), [&](Platform::String^ id)
+        if (mFilter.HasHostFilter() && (present & HostPropertyMask))
         {
-            auto service = mServices.find(id);
-            if (service != mServices.end())
+            auto addresses = record->addresses;
+            state.host = nullptr;
+            if (record->hostName != nullptr && mFilter.MatchHostName(record->hostName->Data()))
             {
-                mServices.erase(service);
+                state.host = FirstAddress(addresses);
             }
-        });
 
-        // restart the service scan
-        mServiceWatcher->Start();
+            // otherwise report the first address that passes the host filter
+            for (unsigned int i = 0; state.host == nullptr && addresses != nullptr && i < addresses->Length; ++i)
+            {
+                if (mFilter.MatchAddress(addresses->get(i)->Data()))
+                {
+                    state.host = addresses->get(i);
+                }
+            }
+            state.hostMatch = state.host != nullptr;
+        }
+
+        host = mFilter.HasHostFilter() ? state.host : FirstAddress(record->addresses);
+        return (!mFilter.HasInstanceNameFilter() || state.instanceNameMatch) &&
+            (!mFilter.HasTxtKeyFilter() || state.txtKeyMatch) &&
+            (!mFilter.HasHostFilter() || state.hostMatch);
+    }
+
+    void DnssdServiceWatcher::OnDnssdServiceUpdated(DnssdServiceShard& shard, DnssdServiceInstance* info, DnssdServiceUpdateType type)
+    {
+        DnssdServiceInfo serviceInfo;
+        serviceInfo.structSize = sizeof(DnssdServiceInfo);
+
+        // an update names the fields that differ from what the client last saw. Flag changes alone leave it 0
+        unsigned int changed = 0;
+        if (type == DnssdServiceUpdateType::ServiceUpdated)
+        {
+            changed |= info->mInstanceName != info->mReportedInstanceName ? DNSSD_FIELD_INSTANCE_NAME : 0;
+            changed |= info->mHost != info->mReportedHost ? DNSSD_FIELD_HOST : 0;
+            changed |= info->mPort != info->mReportedPort ? DNSSD_FIELD_PORT : 0;
+        }
+        bool previous = changed != 0 && mOptions.reportPreviousValues != 0;
+
+        // convert Platform::Strings to UTF-8 in the shard's reusable event arena
+        DnssdStringArena& arena = shard.mEventArena;
+        arena.Reset();
+        AppendPlatformString(arena, info->mHost);
+        AppendPlatformString(arena, info->mPort);
+        AppendPlatformString(arena, info->mInstanceName);
+        AppendPlatformString(arena, info->mId);
+        if (previous)
+        {
+            AppendPlatformString(arena, info->mReportedHost);
+            AppendPlatformString(arena, info->mReportedPort);
+            AppendPlatformString(arena, info->mReportedInstanceName);
+        }
+
+        serviceInfo.host = arena.String(0);
+        serviceInfo.port = arena.String(1);
+        serviceInfo.instanceName = arena.String(2);
+        serviceInfo.id = arena.String(3);
+        serviceInfo.flags = (shard.mServices.Test(info->mSlot, DnssdServiceTable::Provisional) ? DNSSD_SERVICE_FLAG_PROVISIONAL : 0) |
+            (shard.mServices.Test(info->mSlot, DnssdServiceTable::Unhealthy) ? DNSSD_SERVICE_FLAG_UNHEALTHY : 0);
+        serviceInfo.changedFields = changed;
+        serviceInfo.previousHost = previous && (changed & DNSSD_FIELD_HOST) ? arena.String(4) : nullptr;
+        serviceInfo.previousPort = previous && (changed & DNSSD_FIELD_PORT) ? arena.String(5) : nullptr;
+        serviceInfo.previousInstanceName = previous && (changed & DNSSD_FIELD_INSTANCE_NAME) ? arena.String(6) : nullptr;
+
+        if (shard.mStats.firstResultMilliseconds == 0)
+        {
+            shard.mStats.firstResultMilliseconds = MillisecondsSince(mStartTime);
+        }
+
+        info->mReportedHost = info->mHost;
+        info->mReportedPort = info->mPort;
+        info->mReportedInstanceName = info->mInstanceName;
+
+        if (mDnssdServiceChangedCallback == nullptr && mDnssdServiceChangedContextCallback == nullptr && mOptions.executor != DNSSD_EXECUTOR_QUEUE)
+        {
+            return;
+        }
+
+        ++shard.mStats.callbacks;
+
+        if (mExecutor)
+        {
+            // the arena is reused by the next event. Queued events own their strings
+            DnssdServiceEvent event;
+            event.type = type;
+            event.flags = serviceInfo.flags;
+            event.changedFields = changed;
+            event.previousFields = previous ? changed : 0;
+            event.id = serviceInfo.id;
+            event.instanceName = serviceInfo.instanceName;
+            event.host = serviceInfo.host;
+            event.port = serviceInfo.port;
+            if (previous)
+            {
+                event.previousInstanceName = arena.String(6);
+                event.previousHost = arena.String(4);
+                event.previousPort = arena.String(5);
+            }
+            mExecutor->Post(std::move(event));
+        }
+    }
+
+    void DnssdServiceWatcher::InvokeDnssdServiceChangedCallback(DnssdServiceUpdateType type, DnssdServiceInfoPtr info)
+    {
+        // the client may free the handle from the callback. The executor holds a reference to this watcher until it returns
+        if (mDnssdServiceChangedContextCallback != nullptr)
+        {
+            mDnssdServiceChangedContextCallback(mHandle, type, info, mContext);
+        }
+        else if (mDnssdServiceChangedCallback != nullptr)
+        {
+            mDnssdServiceChangedCallback(mHandle, type, info);
+        }
+    }
+
+    void DnssdServiceWatcher::FlushDnssdServiceEvents()
+    {
+        // inline callbacks are made here with no watcher or shard lock held, so a callback may call
+        // into the watcher or free it. The caller must not touch the watcher after this returns
+        if (mExecutor)
+        {
+            mExecutor->Flush();
+        }
+    }
+
+    void DnssdServiceWatcher::DeliverDnssdServiceEvent(const DnssdServiceEvent& event)
+    {
+        // runs on the executor's thread, or inline from FlushDnssdServiceEvents, without the watcher lock
+        DnssdServiceInfo serviceInfo;
+        DnssdServiceEventToInfo(event, serviceInfo);
+        InvokeDnssdServiceChangedCallback(event.type, &serviceInfo);
+    }
+
+    void DnssdServiceWatcher::StartDebounceTimer(DnssdServiceShard& shard, DnssdServiceInstance* info)
+    {
+        if (info->mDebounceTimer != 0)
+        {
+            // a window is already open for this service. Its expiry reports the latest state
+            ++shard.mStats.mergedEvents;
+            return;
+        }
+
+        WeakReference weakThis(this);
+        Platform::String^ serviceId = info->mId;
+        info->mDebounceTimer = DnssdScheduler::Instance().Schedule(mOptions.debounceMilliseconds, [weakThis, serviceId](DnssdTimerId timer)
+        {
+            // the expiry makes inline callbacks. Keep them off the shared scheduler thread
+            create_task([weakThis, serviceId, timer]()
+            {
+                auto watcher = weakThis.Resolve<DnssdServiceWatcher>();
+                if (watcher != nullptr)
+                {
+                    watcher->OnDebounceTimerExpired(serviceId, timer);
+                }
+            });
+        });
+    }
+
+    void DnssdServiceWatcher::EraseDnssdService(DnssdServiceShard& shard, DnssdServiceInstance* info)
+    {
+        // the slot goes back to the table for the next new service
+        CancelDebounceTimer(info);
+        mPicker.Remove(std::wstring(info->mId->Data(), info->mId->Length()));
+        shard.mServices.Erase(info);
+        shard.mStats.instanceSlots = static_cast<unsigned int>(shard.mServices.Capacity());
+    }
+
+    void DnssdServiceWatcher::RemoveDnssdService(DnssdServiceShard& shard, DnssdServiceInstance* info, std::chrono::steady_clock::time_point departed)
+    {
+        // removal supersedes any pending debounced change
+        CancelDebounceTimer(info);
+        OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceRemoved);
+
+        DnssdServiceWatcherStats& stats = shard.mStats;
+        ++stats.removals;
+        stats.lastRemovalMilliseconds = MillisecondsSince(departed);
+        if (stats.lastRemovalMilliseconds > stats.maxRemovalMilliseconds)
+        {
+            stats.maxRemovalMilliseconds = stats.lastRemovalMilliseconds;
+        }
+        shard.mLastRemoval = DnssdClock::Current().Now();
+    }
+
+    void DnssdServiceWatcher::CancelDebounceTimer(DnssdServiceInstance* info)
+    {
+        if (info->mDebounceTimer != 0)
+        {
+            DnssdScheduler::Instance().Cancel(info->mDebounceTimer);
+            info->mDebounceTimer = 0;
+        }
+    }
+
+    void DnssdServiceWatcher::OnDebounceTimerExpired(Platform::String^ serviceId, DnssdTimerId timer)
+    {
+        {
+            DnssdServiceShard& shard = *mShards[ShardIndex(serviceId)];
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+
+            // the service was removed while the window was open, or the window was cancelled after the
+            // scheduler took this task and a newer window is open now
+            DnssdServiceInstance* info = shard.mServices.Find(serviceId);
+            if (info == nullptr || info->mDebounceTimer != timer)
+            {
+                return;
+            }
+
+            info->mDebounceTimer = 0;
+
+            // only report the final state, and only if it differs from what the client last saw
+            if (info->mHost != info->mReportedHost || info->mPort != info->mReportedPort || info->mInstanceName != info->mReportedInstanceName)
+            {
+                OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceUpdated);
+            }
+        }
+        FlushDnssdServiceEvents();
+    }
+
+    static Platform::String^ CacheStringToPlatformString(const std::wstring& s)
+    {
+        return s.empty() ? nullptr : ref new Platform::String(s.c_str(), static_cast<unsigned int>(s.size()));
+    }
+
+    static std::wstring PlatformStringToCacheString(Platform::String^ s)
+    {
+        return s == nullptr ? std::wstring() : std::wstring(s->Data(), s->Length());
+    }
+
+    void DnssdServiceWatcher::LoadServiceCache()
+    {
+        std::vector<DnssdCacheEntry> entries;
+        if (!mCache->Load(entries))
+        {
+            return;
+        }
+
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            // the filters may have changed since the cache was saved. TXT filters are checked when the service is seen again
+            if (!mFilter.MatchInstanceName(it->instanceName.c_str()) ||
+                (mFilter.HasHostFilter() && !mFilter.MatchAddress(it->host.c_str())))
+            {
+                continue;
+            }
+
+            Platform::String^ serviceId = CacheStringToPlatformString(it->id);
+            if (serviceId == nullptr)
+            {
+                continue;
+            }
+
+            DnssdServiceShard& shard = *mShards[ShardIndex(serviceId)];
+            std::lock_guard<std::mutex> shardLock(shard.mMutex);
+            DnssdServiceTable& services = shard.mServices;
+            if (services.Find(serviceId) != nullptr)
+            {
+                continue;
+            }
+
+            DnssdServiceInstance* info = services.Insert(serviceId);
+            services.Assign(info->mHost, TrackedField(DNSSD_FIELD_HOST, CacheStringToPlatformString(it->host)));
+            services.Assign(info->mPort, TrackedField(DNSSD_FIELD_PORT, CacheStringToPlatformString(it->port)));
+            services.Assign(info->mInstanceName, TrackedField(DNSSD_FIELD_INSTANCE_NAME, CacheStringToPlatformString(it->instanceName)));
+            services.Set(info->mSlot, DnssdServiceTable::Provisional, true);
+            info->mCacheExpires = it->expires;
+            services.LastSeen(info->mSlot) = mStartTime;
+
+            // marked for removal so the service expires at the end of the first scan unless the scan finds it
+            services.SetType(info->mSlot, DnssdServiceUpdateType::ServiceRemoved);
+            shard.mStats.instanceSlots = static_cast<unsigned int>(services.Capacity());
+            ++shard.mStats.cachedServices;
+
+            OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceAdded);
+        }
+    }
+
+    void DnssdServiceWatcher::SaveServiceCache()
+    {
+        if (!mCache)
+        {
+            return;
+        }
+
+        unsigned long long expires = DnssdServiceCache::Now() + mOptions.cacheTtlSeconds * DnssdServiceCache::TicksPerSecond;
+
+        // lock every shard for the whole snapshot so the saved table is one consistent view
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto shard = mShards.begin(); shard != mShards.end(); ++shard)
+        {
+            locks.push_back(std::unique_lock<std::mutex>((*shard)->mMutex));
+        }
+
+        std::vector<DnssdCacheEntry> entries;
+        for (auto shard = mShards.begin(); shard != mShards.end(); ++shard)
+        {
+            DnssdServiceTable& services = (*shard)->mServices;
+            for (DnssdSlot slot = 0; slot < services.End(); ++slot)
+            {
+                DnssdServiceInstance* info = services.Record(slot);
+                if (info == nullptr)
+                {
+                    continue;
+                }
+
+                DnssdCacheEntry entry;
+                entry.id = PlatformStringToCacheString(info->mId);
+                entry.instanceName = PlatformStringToCacheString(info->mInstanceName);
+                entry.host = PlatformStringToCacheString(info->mHost);
+                entry.port = PlatformStringToCacheString(info->mPort);
+
+                // a service that was never confirmed keeps the lifetime it was restored with
+                entry.expires = services.Test(slot, DnssdServiceTable::Provisional) ? info->mCacheExpires : expires;
+                entries.push_back(entry);
+            }
+        }
+        locks.clear();
+
+        mCache->Save(entries);
+    }
+
+    static Platform::Array<Platform::String^>^ CacheStringsToPlatformArray(const std::vector<std::wstring>& strings)
+    {
+        auto result = ref new Platform::Array<Platform::String^>(static_cast<unsigned int>(strings.size()));
+        for (unsigned int i = 0; i < result->Length; ++i)
+        {
+            result[i] = CacheStringToPlatformString(strings[i]);
+        }
+        return result;
+    }
+
+    void DnssdServiceWatcher::ScheduleUnicastPoll(unsigned int delayMilliseconds)
+    {
+        WeakReference weakThis(this);
+        mPollTimer = DnssdScheduler::Instance().Schedule(delayMilliseconds, [weakThis](DnssdTimerId timer)
+        {
+            // DnsQuery blocks. Keep it off the shared scheduler thread
+            create_task([weakThis]()
+            {
+                auto watcher = weakThis.Resolve<DnssdServiceWatcher>();
+                if (watcher != nullptr)
+                {
+                    watcher->OnUnicastPoll();
+                }
+            });
+        });
+    }
+
+    void DnssdServiceWatcher::OnUnicastPoll()
+    {
+        // only one poll is outstanding at a time, so the interval needs no lock
+        if (mPollSeconds == 0)
+        {
+            mPollSeconds = mOptions.pollSeconds > 0 ? mOptions.pollSeconds : mUnicastBrowser->PollIntervalSeconds(DefaultPollSeconds);
+        }
+
+        std::vector<DnssdUnicastInstance> instances;
+        std::vector<std::wstring> types;
+        bool browsed = mTypeEnumeration ? mUnicastBrowser->BrowseTypes(types) : mUnicastBrowser->Browse(instances);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+            {
+                return;
+            }
+
+            // a failed browse keeps the current table. Services expire when the server stops returning them
+            if (browsed)
+            {
+                for (auto it = types.begin(); it != types.end(); ++it)
+                {
+                    DnssdServiceRecord record;
+                    record.serviceName = CacheStringToPlatformString(*it);
+                    Dispatch(0, [this, record](DnssdServiceShard& shard) { UpdateDnssdServiceType(shard, record); });
+                }
+
+                for (auto it = instances.begin(); it != instances.end(); ++it)
+                {
+                    DnssdServiceRecord record;
+                    record.hostName = CacheStringToPlatformString(it->hostName);
+                    record.serviceName = CacheStringToPlatformString(it->serviceName);
+                    record.instanceName = CacheStringToPlatformString(it->instanceName);
+                    record.addresses = CacheStringsToPlatformArray(it->addresses);
+                    record.port = CacheStringToPlatformString(it->port);
+                    record.priority = CacheStringToPlatformString(std::to_wstring(it->priority));
+                    record.weight = CacheStringToPlatformString(std::to_wstring(it->weight));
+                    record.textAttributes = CacheStringsToPlatformArray(it->textAttributes);
+                    Platform::String^ serviceId = CacheStringToPlatformString(it->id);
+                    Dispatch(ShardIndex(serviceId), [this, record, serviceId](DnssdServiceShard& shard)
+                    {
+                        UpdateDnssdService(shard, DnssdServiceUpdateType::ServiceAdded, record, serviceId);
+                    });
+                }
+
+                // each poll is a complete scan
+                if (mStats.enumerationMilliseconds == 0)
+                {
+                    mStats.enumerationMilliseconds = MillisecondsSince(mStartTime);
+                }
+                for (unsigned int i = 0; i < mShards.size(); ++i)
+                {
+                    Dispatch(i, [this](DnssdServiceShard& shard) { SweepDnssdServices(shard); });
+                }
+            }
+
+            ScheduleUnicastPoll(mPollSeconds * 1000);
+        }
+        FlushDnssdServiceEvents();
+    }
+
+    void DnssdServiceWatcher::ScheduleProbe(unsigned int delayMilliseconds)
+    {
+        if (mOptions.probeIntervalSeconds == 0)
+        {
+            return;
+        }
+
+        WeakReference weakThis(this);
+        mProbeTimer = DnssdScheduler::Instance().Schedule(delayMilliseconds, [weakThis](DnssdTimerId timer)
+        {
+            // a probe that fails at once reports inline. Keep it off the shared scheduler thread
+            create_task([weakThis]()
+            {
+                auto watcher = weakThis.Resolve<DnssdServiceWatcher>();
+                if (watcher != nullptr)
+                {
+                    watcher->OnProbeTimer();
+                }
+            });
+        });
+    }
+
+    void DnssdServiceWatcher::OnProbeTimer()
+    {
+        struct Probe
+        {
+            Platform::String^ id;
+            Platform::String^ host;
+            Platform::String^ port;
+        };
+        std::vector<Probe> probes;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+            {
+                return;
+            }
+
+            // take the services that are due, up to the rate limit. The rest wait for the next tick
+            auto now = DnssdClock::Current().Now();
+            for (auto shard = mShards.begin(); shard != mShards.end() && probes.size() < mOptions.probesPerSecond; ++shard)
+            {
+                std::lock_guard<std::mutex> shardLock((*shard)->mMutex);
+                DnssdServiceTable& services = (*shard)->mServices;
+                for (DnssdSlot slot = 0; slot < services.End() && probes.size() < mOptions.probesPerSecond; ++slot)
+                {
+                    // the state and deadline arrays decide. Only due services touch their records
+                    if (!services.Test(slot, DnssdServiceTable::Live) || services.Test(slot, DnssdServiceTable::Probing) ||
+                        services.Test(slot, DnssdServiceTable::Provisional) || services.NextProbe(slot) > now)
+                    {
+                        continue;
+                    }
+
+                    DnssdServiceInstance* info = services.Record(slot);
+                    if (info->mHost == nullptr || info->mHost->IsEmpty() || info->mPort == nullptr || info->mPort->IsEmpty())
+                    {
+                        continue;
+                    }
+
+                    services.Set(slot, DnssdServiceTable::Probing, true);
+                    Probe probe = { info->mId, info->mHost, info->mPort };
+                    probes.push_back(probe);
+                }
+            }
+
+            mStats.probes += static_cast<unsigned int>(probes.size());
+            ScheduleProbe(ProbeTickMilliseconds);
+        }
+
+        // connects complete asynchronously. No thread waits for them
+        for (auto it = probes.begin(); it != probes.end(); ++it)
+        {
+            StartProbe(it->id, it->host, it->port);
+        }
+    }
+
+    void DnssdServiceWatcher::StartProbe(Platform::String^ serviceId, Platform::String^ host, Platform::String^ port)
+    {
+        WeakReference weakThis(this);
+        auto complete = [weakThis, serviceId](bool connected)
+        {
+            auto watcher = weakThis.Resolve<DnssdServiceWatcher>();
+            if (watcher != nullptr)
+            {
+                watcher->OnProbeCompleted(serviceId, connected);
+            }
+        };
+
+        StreamSocket^ socket = ref new StreamSocket();
+        IAsyncAction^ connect;
+        try
+        {
+            connect = socket->ConnectAsync(ref new HostName(host), port);
+        }
+        catch (Platform::Exception^ ex)
+        {
+            // not a usable address
+            complete(false);
+            return;
+        }
+
+        // the scheduler cancels a connect that takes too long
+        cancellation_token_source cancel;
+        DnssdTimerId timeout = DnssdScheduler::Instance().Schedule(mOptions.probeTimeoutMilliseconds, [cancel](DnssdTimerId timer)
+        {
+            cancel.cancel();
+        });
+
+        create_task(connect, cancel.get_token()).then([socket, timeout, complete](task<void> previous)
+        {
+            bool connected = true;
+            try
+            {
+                previous.get();
+            }
+            catch (Platform::Exception^ ex)
+            {
+                connected = false;
+            }
+            catch (const task_canceled&)
+            {
+                connected = false;
+            }
+
+            DnssdScheduler::Instance().Cancel(timeout);
+            delete socket;
+            complete(connected);
+        });
+    }
+
+    void DnssdServiceWatcher::OnProbeCompleted(Platform::String^ serviceId, bool connected)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+            {
+                return;
+            }
+
+            if (!connected)
+            {
+                ++mStats.failedProbes;
+            }
+
+            DnssdServiceShard& shard = *mShards[ShardIndex(serviceId)];
+            std::lock_guard<std::mutex> shardLock(shard.mMutex);
+            DnssdServiceTable& services = shard.mServices;
+            DnssdServiceInstance* info = services.Find(serviceId);
+            if (info == nullptr)
+            {
+                return;
+            }
+
+            DnssdSlot slot = info->mSlot;
+            auto now = DnssdClock::Current().Now();
+            services.Set(slot, DnssdServiceTable::Probing, false);
+            services.NextProbe(slot) = now + std::chrono::seconds(mOptions.probeIntervalSeconds);
+
+            bool wasHealthy = !services.Test(slot, DnssdServiceTable::Unhealthy);
+            bool healthy = wasHealthy;
+            if (connected)
+            {
+                info->mProbeFailures = 0;
+                healthy = true;
+            }
+            else if (++info->mProbeFailures < UnhealthyProbeFailures)
+            {
+                // one failure may be a lost packet. Check again on the next tick
+                services.NextProbe(slot) = now;
+            }
+            else
+            {
+                healthy = false;
+            }
+
+            if (healthy != wasHealthy)
+            {
+                // an unhealthy service stays in the table, is not picked and is reported again when it recovers
+                services.Set(slot, DnssdServiceTable::Unhealthy, !healthy);
+                std::wstring id(serviceId->Data(), serviceId->Length());
+                if (healthy)
+                {
+                    mPicker.Update(id, info->mPriority, info->mWeight);
+                }
+                else
+                {
+                    mPicker.Remove(id);
+                }
+
+                CancelDebounceTimer(info);
+                OnDnssdServiceUpdated(shard, info, DnssdServiceUpdateType::ServiceUpdated);
+            }
+        }
+        FlushDnssdServiceEvents();
+    }
+
+    void DnssdServiceWatcher::OnServiceAdded(DeviceWatcher^ sender, DeviceInformation^ args)
+    {
+        DispatchDnssdService(DnssdServiceUpdateType::ServiceAdded, args->Id, args->Properties);
+    }
+
+    void DnssdServiceWatcher::OnServiceUpdated(DeviceWatcher^ sender, DeviceInformationUpdate^ args)
+    {
+        DispatchDnssdService(DnssdServiceUpdateType::ServiceUpdated, args->Id, args->Properties);
+    }
+
+    void DnssdServiceWatcher::OnServiceRemoved(DeviceWatcher^ sender, DeviceInformationUpdate^ args)
+    {
+        // the service has left. Only its id is needed, removal args may not carry any other property
+        auto departed = DnssdClock::Current().Now();
+
+        Platform::String^ serviceId = args->Id;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+            {
+                return;
+            }
+
+            Dispatch(ShardIndex(serviceId), [this, serviceId, departed](DnssdServiceShard& shard)
+            {
+                ++shard.mStats.backendEvents;
+
+                // the type registry is keyed by type. A type expires when a scan no longer finds any instance of it
+                if (mTypeEnumeration)
+                {
+                    return;
+                }
+
+                shard.mFilterStates.erase(serviceId);
+                DnssdServiceInstance* info = shard.mServices.Find(serviceId);
+                if (info != nullptr)
+                {
+                    RemoveDnssdService(shard, info, departed);
+                    EraseDnssdService(shard, info);
+                }
+            });
+        }
+        FlushDnssdServiceEvents();
+    }
+
+    void DnssdServiceWatcher::OnServiceEnumerationCompleted(DeviceWatcher^ sender, Platform::Object^ args)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mRunning)
+        {
+            return;
+        }
+
+        if (mStats.enumerationMilliseconds == 0)
+        {
+            mStats.enumerationMilliseconds = MillisecondsSince(mStartTime);
+        }
+
+        // stop the service scanning. Service scanning will be restarted when OnServiceEnumerationStopped event is received
+        mServiceWatcher->Stop();
+    }
+
+    void DnssdServiceWatcher::OnServiceEnumerationStopped(Windows::Devices::Enumeration::DeviceWatcher^ sender, Platform::Object^ args)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // check if we are shutting down
+            if (!mRunning)
+            {
+                return;
+            }
+
+            // each shard sweeps once the changes of this scan queued before the sweep are applied.
+            // Changes of the next scan are queued behind it
+            for (unsigned int i = 0; i < mShards.size(); ++i)
+            {
+                Dispatch(i, [this](DnssdServiceShard& shard) { SweepDnssdServices(shard); });
+            }
+
+            // restart the service scan
+            mServiceWatcher->Start();
+        }
+        FlushDnssdServiceEvents();
+    }
+
+    void DnssdServiceWatcher::SweepDnssdServices(DnssdServiceShard& shard)
+    {
+        DnssdServiceTable& services = shard.mServices;
+
+        // walk the type array and remove any service that is marked for removal. Slots never move, so
+        // a service can be erased in place; only the removed ones touch their records
+        for (DnssdSlot slot = 0; slot < services.End(); ++slot)
+        {
+            if (!services.Test(slot, DnssdServiceTable::Live))
+            {
+                continue;
+            }
+
+            if (services.Type(slot) == DnssdServiceUpdateType::ServiceRemoved)
+            {
+                // a service that left without a removal event. Report it as gone since it was last seen
+                DnssdServiceInstance* service = services.Record(slot);
+                RemoveDnssdService(shard, service, services.LastSeen(slot));
+                EraseDnssdService(shard, service);
+            }
+            else // prepare the service for the next search
+            {
+                // for each scan we mark each service as removed. 
+                // If the scan finds the service again we will update its state accordingly
+                services.SetType(slot, DnssdServiceUpdateType::ServiceRemoved);
+                services.Set(slot, DnssdServiceTable::Changed, false);
+            }
+        }
+
+        // the filter states of services this scan did not see, accepted or not
+        for (auto it = shard.mFilterStates.begin(); it != shard.mFilterStates.end();)
+        {
+            it = it->second.scan != shard.mScan ? shard.mFilterStates.erase(it) : std::next(it);
+        }
+        ++shard.mScan;
     }
 }
 
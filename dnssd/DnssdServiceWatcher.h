@@ -15,8 +15,23 @@
 #include <string>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
 
 #include "dnssd.h"
+#include "DnssdServiceFilter.h"
+#include "DnssdScheduler.h"
+#include "DnssdProperties.h"
+#include "DnssdStringArena.h"
+#include "DnssdServiceCache.h"
+#include "DnssdExecutor.h"
+#include "DnssdUnicastBrowser.h"
+#include "DnssdWorkQueue.h"
+#include "DnssdInstancePicker.h"
+#include "DnssdServiceTable.h"
 
 namespace dnssd_uwp
 {
@@ -28,22 +43,40 @@ namespace dnssd_uwp
     // WinRT Delegate
     delegate void DnssdServiceUpdateHandler(DnssdServiceWatcher^ sender, DnssdServiceUpdateType update, DnssdServiceInfoPtr info);
 
-    ref class DnssdServiceInstance sealed
+    // What the filters know of one service. An update event only carries the properties that changed,
+    // so the filters see the properties merged over all events of the service, accepted or not
+    struct DnssdFilterState
     {
-    public:
-        DnssdServiceInstance()
-        {
-            mChanged = false;
-            mType = DnssdServiceUpdateType::ServiceAdded;
-        }
+        DnssdFilterState() : instanceNameMatch(false), txtKeyMatch(false), hostMatch(false), scan(0) {}
+
+        DnssdServiceRecord record;
+        Platform::String^ host;                     // the address that passed the host filter
+        bool instanceNameMatch;
+        bool txtKeyMatch;
+        bool hostMatch;
+        unsigned int scan;                          // the scan that last saw the service
+    };
 
-    internal:
-        Platform::String^ mHost;
-        Platform::String^ mPort;
-        Platform::String^ mInstanceName;
-        Platform::String^ mId;
-        DnssdServiceUpdateType mType;
-        bool mChanged;
+    // Part of a watcher's service table. A service belongs to the shard picked by its hashed id,
+    // and every change to it is applied in order on that shard's queue, so shards update in parallel
+    struct DnssdServiceShard
+    {
+        std::mutex mMutex;
+        DnssdServiceTable mServices;
+
+        // watchers with filters only. By service id, including the services the filters reject
+        std::unordered_map<Platform::String^, DnssdFilterState, DnssdStringHash, DnssdStringEqual> mFilterStates;
+        unsigned int mScan;
+
+        // UTF-8 strings of the event being delivered. Reused for every callback
+        DnssdStringArena mEventArena;
+
+        // counters of this shard. GetStats adds them up
+        DnssdServiceWatcherStats mStats;
+        std::chrono::steady_clock::time_point mLastRemoval;
+
+        // nullptr if the watcher has a single shard, which is updated on the thread that received the change
+        std::unique_ptr<DnssdWorkQueue> mQueue;
     };
 
     ref class DnssdServiceWatcher
@@ -54,8 +87,21 @@ namespace dnssd_uwp
     internal:
         DnssdErrorType Initialize();
 
+        // stop watching, save the warm-start cache and release the DeviceWatcher. No callbacks are made after Stop returns
+        void Stop();
+
+        void GetStats(DnssdServiceWatcherStats& stats);
+
+        // pull delivery for DNSSD_EXECUTOR_QUEUE watchers
+        void* GetEventHandle();
+        DnssdErrorType Poll(DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int& count);
+
+        // strings of info are valid until the next pick
+        DnssdErrorType PickInstance(DnssdPickPolicy policy, DnssdServiceInfo& info);
+
         void RemoveDnssdServiceChangedCallback() {
             mDnssdServiceChangedCallback = nullptr;
+            mDnssdServiceChangedContextCallback = nullptr;
         };
 
         //event DnssdServiceUpdateHandler^ mPortUpdateEventHander;
@@ -64,25 +110,101 @@ namespace dnssd_uwp
         void SetDnssdServiceChangedCallback(const DnssdServiceChangedCallback callback) {
             mDnssdServiceChangedCallback = callback;
         };
+
+        // must be set before Initialize
+        void SetDnssdServiceChangedContextCallback(const DnssdServiceChangedContextCallback callback, void* context) {
+            mDnssdServiceChangedContextCallback = callback;
+            mContext = context;
+        };
+
+        // the handle returned by the create functions, passed to every callback. Must be set before Initialize
+        void SetHandle(DnssdServiceWatcherPtr handle) {
+            mHandle = handle;
+        };
        
         // Constructor needs to be internal as this is an unsealed ref base class
-        DnssdServiceWatcher(const char* serviceType, DnssdServiceChangedCallback callback = nullptr);
+        DnssdServiceWatcher(const char* serviceType, const DnssdServiceWatcherOptions& options, DnssdServiceChangedCallback callback = nullptr);
 
     private:
+        typedef std::function<void(DnssdServiceShard& shard)> DnssdShardWork;
+
         void OnServiceAdded(Windows::Devices::Enumeration::DeviceWatcher^ sender, Windows::Devices::Enumeration::DeviceInformation^ args);
         void OnServiceRemoved(Windows::Devices::Enumeration::DeviceWatcher^ sender, Windows::Devices::Enumeration::DeviceInformationUpdate^ args);
         void OnServiceUpdated(Windows::Devices::Enumeration::DeviceWatcher^ sender, Windows::Devices::Enumeration::DeviceInformationUpdate^ args);
         void OnServiceEnumerationCompleted(Windows::Devices::Enumeration::DeviceWatcher^ sender, Platform::Object^ args);
         void OnServiceEnumerationStopped(Windows::Devices::Enumeration::DeviceWatcher^ sender, Platform::Object^ args);
-        void UpdateDnssdService(DnssdServiceUpdateType type, Windows::Foundation::Collections::IMapView<Platform::String^, Platform::Object^>^ props, Platform::String^ serviceId);
-        void OnDnssdServiceUpdated(DnssdServiceInstance^ info);
+        void DispatchDnssdService(DnssdServiceUpdateType type, Platform::String^ serviceId, Windows::Foundation::Collections::IMapView<Platform::String^, Platform::Object^>^ properties);
+        void Dispatch(unsigned int shardIndex, const DnssdShardWork& work);
+        unsigned int ShardIndex(Platform::String^ serviceId) const;
+        void UpdateDnssdService(DnssdServiceShard& shard, DnssdServiceUpdateType type, const DnssdServiceRecord& record, Platform::String^ serviceId);
+        void UpdateDnssdServiceType(DnssdServiceShard& shard, const DnssdServiceRecord& record);
+        bool FilterDnssdService(DnssdServiceShard& shard, Platform::String^ serviceId, unsigned int present, const DnssdServiceRecord*& record, Platform::String^& host);
+        Platform::String^ TrackedField(unsigned int field, Platform::String^ value) const { return (mFieldMask & field) ? value : nullptr; }
+        void OnDnssdServiceUpdated(DnssdServiceShard& shard, DnssdServiceInstance* info, DnssdServiceUpdateType type);
+        void InvokeDnssdServiceChangedCallback(DnssdServiceUpdateType type, DnssdServiceInfoPtr info);
+        void DeliverDnssdServiceEvent(const DnssdServiceEvent& event);
+        void FlushDnssdServiceEvents();
+        void StartDebounceTimer(DnssdServiceShard& shard, DnssdServiceInstance* info);
+        void CancelDebounceTimer(DnssdServiceInstance* info);
+        void EraseDnssdService(DnssdServiceShard& shard, DnssdServiceInstance* info);
+        void RemoveDnssdService(DnssdServiceShard& shard, DnssdServiceInstance* info, std::chrono::steady_clock::time_point departed);
+        void OnDebounceTimerExpired(Platform::String^ serviceId, DnssdTimerId timer);
+        void LoadServiceCache();
+        void SweepDnssdServices(DnssdServiceShard& shard);
+        void ClearDnssdServices();
+        void ScheduleUnicastPoll(unsigned int delayMilliseconds);
+        void OnUnicastPoll();
+        void ScheduleProbe(unsigned int delayMilliseconds);
+        void OnProbeTimer();
+        void StartProbe(Platform::String^ serviceId, Platform::String^ host, Platform::String^ port);
+        void OnProbeCompleted(Platform::String^ serviceId, bool connected);
+        void StopServiceWatcher();
+        DnssdErrorType StartDeviceWatcher();
+        void SaveServiceCache();
 
         Windows::Devices::Enumeration::DeviceWatcher^ mServiceWatcher;
+        Windows::Foundation::EventRegistrationToken mAddedToken;
+        Windows::Foundation::EventRegistrationToken mRemovedToken;
+        Windows::Foundation::EventRegistrationToken mUpdatedToken;
+        Windows::Foundation::EventRegistrationToken mEnumerationCompletedToken;
+        Windows::Foundation::EventRegistrationToken mStoppedToken;
 
         DnssdServiceChangedCallback mDnssdServiceChangedCallback;
+        DnssdServiceChangedContextCallback mDnssdServiceChangedContextCallback;
+        void* mContext;
+        DnssdServiceWatcherPtr mHandle;
+
+        // delivers callbacks. Inline callbacks are made by FlushDnssdServiceEvents once the locks are released
+        std::unique_ptr<DnssdExecutor> mExecutor;
+
+        // wide-area browsing. Replaces the DeviceWatcher when a unicast domain is configured
+        std::unique_ptr<DnssdUnicastBrowser> mUnicastBrowser;
+        unsigned int mPollSeconds;
+        DnssdTimerId mPollTimer;
+
+        // liveness probing. One timer per watcher starts a rate limited batch of probes each second
+        DnssdTimerId mProbeTimer;
+
+        // the service table. Fixed once the watcher is initialized
+        std::vector<std::unique_ptr<DnssdServiceShard>> mShards;
+
+        // the live instances for dnssd_pick_instance(). Updated by the shards with every change to a confirmed service
+        DnssdInstancePicker mPicker;
+        std::mutex mPickMutex;
+        DnssdStringArena mPickArena;
 
-        std::map<Platform::String^, DnssdServiceInstance^> mServices;
         Platform::String^ mServiceName;
+
+        // browsing DNSSD_SERVICE_TYPE_ENUMERATION. The single shard is then the registry of types keyed by type
+        bool mTypeEnumeration;
+        DnssdServiceWatcherOptions mOptions;
+        DnssdServiceFilter mFilter;
+        unsigned int mPropertyMask;
+        unsigned int mFieldMask;                    // DnssdServiceFields tracked for each service
+        std::unique_ptr<DnssdServiceCache> mCache;
+        DnssdServiceWatcherStats mStats;            // watcher wide counters. Service counters are kept per shard
+        std::chrono::steady_clock::time_point mStartTime;
+        std::mutex mMutex;
         bool mRunning;
     };
 
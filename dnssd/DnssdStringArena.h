@@ -0,0 +1,57 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace dnssd_uwp
+{
+    // Growable character arena for the strings of one event. Reset() keeps the
+    // capacity, so once the arena has grown to fit the largest event no further
+    // allocations are made.
+    class DnssdStringArena
+    {
+    public:
+        void Reset()
+        {
+            mBuffer.clear();
+            mOffsets.clear();
+        }
+
+        // reserve length + 1 bytes and return the offset of the new string
+        size_t Append(size_t length)
+        {
+            size_t offset = mBuffer.size();
+            mBuffer.resize(offset + length + 1);
+            mOffsets.push_back(offset);
+            return offset;
+        }
+
+        char* Data(size_t offset)
+        {
+            return &mBuffer[offset];
+        }
+
+        // string pointers are only stable once every string of the event has been appended
+        const char* String(size_t index) const
+        {
+            return mBuffer.data() + mOffsets[index];
+        }
+
+    private:
+        std::vector<char> mBuffer;
+        std::vector<size_t> mOffsets;
+    };
+};
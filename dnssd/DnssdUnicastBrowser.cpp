@@ -0,0 +1,315 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdUnicastBrowser.h"
+#include "DnssdUtils.h"
+#include <cctype>
+#include <cwchar>
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windns.h>
+
+// needed for DnsQuery and InetPton/InetNtop
+#pragma comment(lib, "dnsapi.lib")
+#pragma comment(lib, "ws2_32.lib")
+
+namespace dnssd_uwp
+{
+    static const unsigned int MinPollSeconds = 10;
+    static const unsigned int MaxPollSeconds = 3600;
+
+    // record list returned by DnsQuery
+    class DnsRecordList
+    {
+    public:
+        DnsRecordList()
+            : mRecords(nullptr)
+        {
+        }
+
+        ~DnsRecordList()
+        {
+            if (mRecords != nullptr)
+            {
+                DnsRecordListFree(mRecords, DnsFreeRecordList);
+            }
+        }
+
+        PDNS_RECORD* Put() { return &mRecords; }
+        PDNS_RECORD First() const { return mRecords; }
+
+    private:
+        DnsRecordList(const DnsRecordList&) = delete;
+        DnsRecordList& operator=(const DnsRecordList&) = delete;
+
+        PDNS_RECORD mRecords;
+    };
+
+    static DNS_STATUS Query(const std::wstring& name, WORD type, const std::vector<unsigned char>& servers, DnsRecordList& records)
+    {
+        // answers from a configured server must not come from the system cache
+        DWORD options = servers.empty() ? DNS_QUERY_STANDARD : DNS_QUERY_BYPASS_CACHE;
+        PVOID extra = servers.empty() ? nullptr : const_cast<unsigned char*>(servers.data());
+        return DnsQuery_W(name.c_str(), type, options, extra, records.Put(), nullptr);
+    }
+
+    static bool IsAnswer(PDNS_RECORD record, WORD type)
+    {
+        return record->wType == type && record->Flags.S.Section == DnsSectionAnswer;
+    }
+
+    static std::wstring StripTrailingDot(const wchar_t* name)
+    {
+        std::wstring s(name != nullptr ? name : L"");
+        if (!s.empty() && s.back() == L'.')
+        {
+            s.pop_back();
+        }
+        return s;
+    }
+
+    static bool IsDigit(char c)
+    {
+        return isdigit(static_cast<unsigned char>(c)) != 0;
+    }
+
+    // DNS names escape '.', '\' and non printable bytes in labels as \c and \DDD. A \DDD escape is one byte
+    // of the label's UTF-8, so the escapes are undone on the UTF-8 form and the result decoded once
+    static std::wstring UnescapeLabel(const std::wstring& label)
+    {
+        std::string utf8 = WideStringToUtf8(label);
+        std::string result;
+        for (size_t i = 0; i < utf8.size(); ++i)
+        {
+            if (utf8[i] == '\\' && i + 3 < utf8.size() && IsDigit(utf8[i + 1]) && IsDigit(utf8[i + 2]) && IsDigit(utf8[i + 3]))
+            {
+                result += static_cast<char>((utf8[i + 1] - '0') * 100 + (utf8[i + 2] - '0') * 10 + (utf8[i + 3] - '0'));
+                i += 3;
+            }
+            else if (utf8[i] == '\\' && i + 1 < utf8.size())
+            {
+                result += utf8[++i];
+            }
+            else
+            {
+                result += utf8[i];
+            }
+        }
+        return Utf8ToWideString(result.c_str());
+    }
+
+    // name without ".suffix", or name itself if it does not end with it. DNS names compare case insensitively
+    static std::wstring RemoveSuffix(const std::wstring& name, const std::wstring& suffix)
+    {
+        std::wstring dotted = L"." + suffix;
+        if (name.size() > dotted.size() && _wcsicmp(name.c_str() + name.size() - dotted.size(), dotted.c_str()) == 0)
+        {
+            return name.substr(0, name.size() - dotted.size());
+        }
+        return name;
+    }
+
+    DnssdUnicastBrowser::DnssdUnicastBrowser(const std::wstring& serviceType, const std::wstring& domain)
+        : mServiceType(serviceType)
+        , mDomain(domain)
+    {
+    }
+
+    DnssdErrorType DnssdUnicastBrowser::Initialize(const char* server)
+    {
+        if (server == nullptr || *server == 0)
+        {
+            return DNSSD_NO_ERROR;
+        }
+
+        IN_ADDR address;
+        if (InetPtonA(AF_INET, server, &address) != 1)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        mServers.resize(sizeof(IP4_ARRAY));
+        PIP4_ARRAY servers = reinterpret_cast<PIP4_ARRAY>(mServers.data());
+        servers->AddrCount = 1;
+        servers->AddrArray[0] = address.S_un.S_addr;
+        return DNSSD_NO_ERROR;
+    }
+
+    bool DnssdUnicastBrowser::QueryPointers(const std::wstring& name, std::vector<std::wstring>& targets)
+    {
+        DnsRecordList records;
+        DNS_STATUS status = Query(name, DNS_TYPE_PTR, mServers, records);
+        if (status == DNS_ERROR_RCODE_NAME_ERROR || status == DNS_INFO_NO_RECORDS)
+        {
+            // nothing registered
+            return true;
+        }
+        else if (status != ERROR_SUCCESS)
+        {
+            return false;
+        }
+
+        for (PDNS_RECORD record = records.First(); record != nullptr; record = record->pNext)
+        {
+            if (IsAnswer(record, DNS_TYPE_PTR))
+            {
+                targets.push_back(StripTrailingDot(record->Data.PTR.pNameHost));
+            }
+        }
+        return true;
+    }
+
+    bool DnssdUnicastBrowser::Browse(std::vector<DnssdUnicastInstance>& instances)
+    {
+        std::wstring browseName = mServiceType + L"." + mDomain;
+        std::vector<std::wstring> targets;
+        if (!QueryPointers(browseName, targets))
+        {
+            return false;
+        }
+
+        for (auto it = targets.begin(); it != targets.end(); ++it)
+        {
+            DnssdUnicastInstance instance;
+            instance.id = *it;
+            instance.instanceName = UnescapeLabel(RemoveSuffix(*it, browseName));
+            instance.serviceName = mServiceType;
+
+            // an instance whose SRV record is gone is left out and expires like a vanished mDNS service
+            if (ResolveInstance(*it, instance))
+            {
+                instances.push_back(instance);
+            }
+        }
+        return true;
+    }
+
+    bool DnssdUnicastBrowser::BrowseTypes(std::vector<std::wstring>& types)
+    {
+        std::vector<std::wstring> targets;
+        if (!QueryPointers(L"_services._dns-sd._udp." + mDomain, targets))
+        {
+            return false;
+        }
+
+        for (auto it = targets.begin(); it != targets.end(); ++it)
+        {
+            types.push_back(RemoveSuffix(*it, mDomain));
+        }
+        return true;
+    }
+
+    bool DnssdUnicastBrowser::ResolveInstance(const std::wstring& name, DnssdUnicastInstance& instance)
+    {
+        DnsRecordList srv;
+        if (Query(name, DNS_TYPE_SRV, mServers, srv) != ERROR_SUCCESS)
+        {
+            return false;
+        }
+
+        // lowest priority, then highest weight
+        PDNS_RECORD target = nullptr;
+        for (PDNS_RECORD record = srv.First(); record != nullptr; record = record->pNext)
+        {
+            if (IsAnswer(record, DNS_TYPE_SRV) &&
+                (target == nullptr || record->Data.SRV.wPriority < target->Data.SRV.wPriority ||
+                (record->Data.SRV.wPriority == target->Data.SRV.wPriority && record->Data.SRV.wWeight > target->Data.SRV.wWeight)))
+            {
+                target = record;
+            }
+        }
+
+        if (target == nullptr)
+        {
+            return false;
+        }
+
+        instance.hostName = StripTrailingDot(target->Data.SRV.pNameTarget);
+        instance.port = std::to_wstring(target->Data.SRV.wPort);
+        instance.priority = target->Data.SRV.wPriority;
+        instance.weight = target->Data.SRV.wWeight;
+
+        // the TXT record is optional
+        DnsRecordList txt;
+        if (Query(name, DNS_TYPE_TEXT, mServers, txt) == ERROR_SUCCESS)
+        {
+            for (PDNS_RECORD record = txt.First(); record != nullptr; record = record->pNext)
+            {
+                if (IsAnswer(record, DNS_TYPE_TEXT))
+                {
+                    for (DWORD i = 0; i < record->Data.TXT.dwStringCount; ++i)
+                    {
+                        instance.textAttributes.push_back(record->Data.TXT.pStringArray[i]);
+                    }
+                }
+            }
+        }
+
+        ResolveAddresses(instance.hostName, instance.addresses);
+        return true;
+    }
+
+    void DnssdUnicastBrowser::ResolveAddresses(const std::wstring& hostName, std::vector<std::wstring>& addresses)
+    {
+        wchar_t buffer[INET6_ADDRSTRLEN];
+
+        DnsRecordList ipv4;
+        if (Query(hostName, DNS_TYPE_A, mServers, ipv4) == ERROR_SUCCESS)
+        {
+            for (PDNS_RECORD record = ipv4.First(); record != nullptr; record = record->pNext)
+            {
+                if (IsAnswer(record, DNS_TYPE_A) && InetNtopW(AF_INET, &record->Data.A.IpAddress, buffer, INET6_ADDRSTRLEN) != nullptr)
+                {
+                    addresses.push_back(buffer);
+                }
+            }
+        }
+
+        DnsRecordList ipv6;
+        if (Query(hostName, DNS_TYPE_AAAA, mServers, ipv6) == ERROR_SUCCESS)
+        {
+            for (PDNS_RECORD record = ipv6.First(); record != nullptr; record = record->pNext)
+            {
+                if (IsAnswer(record, DNS_TYPE_AAAA) && InetNtopW(AF_INET6, &record->Data.AAAA.Ip6Address, buffer, INET6_ADDRSTRLEN) != nullptr)
+                {
+                    addresses.push_back(buffer);
+                }
+            }
+        }
+    }
+
+    unsigned int DnssdUnicastBrowser::PollIntervalSeconds(unsigned int defaultSeconds)
+    {
+        DnsRecordList soa;
+        if (Query(mDomain, DNS_TYPE_SOA, mServers, soa) != ERROR_SUCCESS)
+        {
+            return defaultSeconds;
+        }
+
+        for (PDNS_RECORD record = soa.First(); record != nullptr; record = record->pNext)
+        {
+            if (IsAnswer(record, DNS_TYPE_SOA))
+            {
+                // a new instance is visible once the negative cache entry for it expires
+                unsigned int seconds = record->Data.SOA.dwDefaultTtl;
+                if (record->dwTtl < seconds)
+                {
+                    seconds = record->dwTtl;
+                }
+                return seconds < MinPollSeconds ? MinPollSeconds : seconds > MaxPollSeconds ? MaxPollSeconds : seconds;
+            }
+        }
+
+        return defaultSeconds;
+    }
+}
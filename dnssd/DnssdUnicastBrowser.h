@@ -0,0 +1,69 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dnssd.h"
+
+namespace dnssd_uwp
+{
+    // one service instance found by a unicast browse
+    struct DnssdUnicastInstance
+    {
+        std::wstring id;                            // full instance name, e.g. "printer._ipp._tcp.example.com"
+        std::wstring instanceName;
+        std::wstring serviceName;
+        std::wstring hostName;
+        std::wstring port;
+        unsigned short priority;                    // of the SRV record used
+        unsigned short weight;
+        std::vector<std::wstring> addresses;
+        std::vector<std::wstring> textAttributes;
+    };
+
+    // Wide-area DNS-SD (RFC 6763) browser for a unicast DNS domain.
+    // Each Browse is one blocking PTR, SRV, TXT and address lookup pass against the
+    // configured server, or the system resolvers if none is set. Browsing is polled;
+    // DNS Push notifications (RFC 8765) are not supported by the Windows resolver.
+    class DnssdUnicastBrowser
+    {
+    public:
+        DnssdUnicastBrowser(const std::wstring& serviceType, const std::wstring& domain);
+
+        // server is an IPv4 address. nullptr uses the system resolvers
+        DnssdErrorType Initialize(const char* server);
+
+        // find the instances of the service type. Returns false if the browse query failed
+        bool Browse(std::vector<DnssdUnicastInstance>& instances);
+
+        // find the service types registered in the domain. Returns false if the browse query failed
+        bool BrowseTypes(std::vector<std::wstring>& types);
+
+        // poll interval derived from the domain's SOA record: the negative caching TTL,
+        // capped by the record TTL and clamped to a sane range. defaultSeconds if there is no SOA
+        unsigned int PollIntervalSeconds(unsigned int defaultSeconds);
+
+    private:
+        bool QueryPointers(const std::wstring& name, std::vector<std::wstring>& targets);
+        bool ResolveInstance(const std::wstring& name, DnssdUnicastInstance& instance);
+        void ResolveAddresses(const std::wstring& hostName, std::vector<std::wstring>& addresses);
+
+        std::wstring mServiceType;
+        std::wstring mDomain;
+
+        // IP4_ARRAY passed to DnsQuery. Empty for the system resolvers
+        std::vector<unsigned char> mServers;
+    };
+};
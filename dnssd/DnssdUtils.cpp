@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <cvt/wstring>
 #include <codecvt>
+#include <cstring>
 #include <memory>
 
 #define WIN32_LEAN_AND_MEAN
@@ -38,6 +39,59 @@ namespace dnssd_uwp
         return std::string(utf8.get());
     }
 
+    void AppendPlatformString(DnssdStringArena& arena, Platform::String^ s)
+    {
+        int length = static_cast<int>(s->Length());
+        if (length == 0)
+        {
+            arena.Append(0);
+            return;
+        }
+
+        int bufferSize = WideCharToMultiByte(CP_UTF8, 0, s->Data(), length, nullptr, 0, NULL, NULL);
+        size_t offset = arena.Append(bufferSize);
+        if (0 == WideCharToMultiByte(CP_UTF8, 0, s->Data(), length, arena.Data(offset), bufferSize, NULL, NULL))
+            throw std::exception("Can't convert string to UTF8");
+    }
+
+    void CopyDnssdServiceInfo(const DnssdServiceInfo& info, DnssdServiceInfo* target, size_t size)
+    {
+        size = (std::min)(size, sizeof(DnssdServiceInfo));
+        memcpy(target, &info, size);
+        target->structSize = static_cast<unsigned int>(size);
+    }
+
+    std::wstring Utf8ToWideString(const char* s)
+    {
+        int bufferSize = MultiByteToWideChar(CP_UTF8, 0, s, -1, nullptr, 0);
+        if (bufferSize <= 1)
+        {
+            return std::wstring();
+        }
+
+        std::wstring w(bufferSize - 1, L'\0');
+        if (0 == MultiByteToWideChar(CP_UTF8, 0, s, -1, &w[0], bufferSize))
+            throw std::exception("Can't convert string from UTF8");
+
+        return w;
+    }
+
+    std::string WideStringToUtf8(const std::wstring& s)
+    {
+        if (s.empty())
+        {
+            return std::string();
+        }
+
+        int length = static_cast<int>(s.size());
+        int bufferSize = WideCharToMultiByte(CP_UTF8, 0, s.data(), length, nullptr, 0, NULL, NULL);
+        std::string utf8(bufferSize, '\0');
+        if (0 == WideCharToMultiByte(CP_UTF8, 0, s.data(), length, &utf8[0], bufferSize, NULL, NULL))
+            throw std::exception("Can't convert string to UTF8");
+
+        return utf8;
+    }
+
     std::string PlatformStringToString2(Platform::String^ s)
     {
         stdext::cvt::wstring_convert<std::codecvt_utf8<wchar_t>> convert;
@@ -17,12 +17,22 @@
 #include <string>
 
 #include "dnssd.h"
+#include "DnssdStringArena.h"
 
 namespace dnssd_uwp
 {
     Platform::String^ StringToPlatformString(const std::string& s);
     std::string PlatformStringToString(Platform::String^ s);
     std::string PlatformStringToString2(Platform::String^ s);
+    std::wstring Utf8ToWideString(const char* s);
+    std::string WideStringToUtf8(const std::wstring& s);
+
+    // copy info into a caller's struct of size bytes, which may come from an older or newer dnssd.h.
+    // Only the members both know are written, and target->structSize is set to the bytes written. size must cover structSize
+    void CopyDnssdServiceInfo(const DnssdServiceInfo& info, DnssdServiceInfo* target, size_t size);
+
+    // convert s to UTF-8 directly into the arena
+    void AppendPlatformString(DnssdStringArena& arena, Platform::String^ s);
 };
 
 
@@ -0,0 +1,110 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#include "DnssdWorkQueue.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace Windows::Foundation;
+using namespace Windows::System::Threading;
+
+namespace dnssd_uwp
+{
+    struct DnssdWorkQueueState
+    {
+        DnssdWorkQueueState()
+            : stopped(false)
+            , draining(false)
+            , running(0)
+        {
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<DnssdWorkQueue::Work> queue;
+        bool stopped;
+        bool draining;                              // a pool thread owns the queue
+        unsigned int running;                       // work items in progress
+    };
+
+    // queue whose work item is running on this thread
+    static thread_local DnssdWorkQueueState* tWorking = nullptr;
+
+    static void Drain(DnssdWorkQueueState& state)
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (!state.stopped && !state.queue.empty())
+        {
+            DnssdWorkQueue::Work work = std::move(state.queue.front());
+            state.queue.pop_front();
+
+            ++state.running;
+            lock.unlock();
+
+            tWorking = &state;
+            work();
+            tWorking = nullptr;
+
+            lock.lock();
+            --state.running;
+            state.condition.notify_all();
+        }
+        state.draining = false;
+    }
+
+    DnssdWorkQueue::DnssdWorkQueue()
+        : mState(std::make_shared<DnssdWorkQueueState>())
+    {
+    }
+
+    DnssdWorkQueue::~DnssdWorkQueue()
+    {
+        Shutdown();
+    }
+
+    void DnssdWorkQueue::Post(Work&& work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mState->mutex);
+            if (mState->stopped)
+            {
+                return;
+            }
+
+            mState->queue.push_back(std::move(work));
+            if (mState->draining)
+            {
+                // the pool thread draining the queue runs this item after the ones before it
+                return;
+            }
+            mState->draining = true;
+        }
+
+        auto state = mState;
+        ThreadPool::RunAsync(ref new WorkItemHandler([state](IAsyncAction^ action)
+        {
+            Drain(*state);
+        }));
+    }
+
+    void DnssdWorkQueue::Shutdown()
+    {
+        std::unique_lock<std::mutex> lock(mState->mutex);
+        mState->stopped = true;
+        mState->queue.clear();
+
+        // a work item that shuts down its own queue cannot wait for itself
+        unsigned int self = tWorking == mState.get() ? 1 : 0;
+        mState->condition.wait(lock, [this, self] { return mState->running <= self; });
+    }
+}
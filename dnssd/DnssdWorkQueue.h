@@ -0,0 +1,46 @@
+// ******************************************************************
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THE CODE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+// THE CODE OR THE USE OR OTHER DEALINGS IN THE CODE.
+// ******************************************************************
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+namespace dnssd_uwp
+{
+    struct DnssdWorkQueueState;
+
+    // Runs work items in order on the thread pool, one at a time.
+    // Different queues run in parallel. The queue lives in state shared with the
+    // pool thread draining it, so a work item may shut down its own queue.
+    class DnssdWorkQueue
+    {
+    public:
+        typedef std::function<void()> Work;
+
+        DnssdWorkQueue();
+        ~DnssdWorkQueue();
+
+        // queue work after the items already queued. Never waits for them
+        void Post(Work&& work);
+
+        // drop queued items and wait for an item in progress on another thread to return.
+        // Must not be called while holding a lock the work items take
+        void Shutdown();
+
+    private:
+        DnssdWorkQueue(const DnssdWorkQueue&) = delete;
+        DnssdWorkQueue& operator=(const DnssdWorkQueue&) = delete;
+
+        std::shared_ptr<DnssdWorkQueueState> mState;
+    };
+};
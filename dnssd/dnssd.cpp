@@ -13,6 +13,10 @@
 #include "dnssd.h"
 #include "DnssdService.h"
 #include "DnssdServiceWatcher.h"
+#include "DnssdReflector.h"
+#include "DnssdUtils.h"
+#include <cstddef>
+#include <cstring>
 #include <wrl\wrappers\corewrappers.h>
 
 
@@ -20,6 +24,12 @@ namespace dnssd_uwp
 {
     static bool mInitialized = false;
 
+    // the smallest DnssdServiceInfo and DnssdServiceWatcherEvent callers may pass: the service's id, name, host and port, and structSize
+    static const size_t MinServiceInfoSize = offsetof(DnssdServiceInfo, structSize) + sizeof(DnssdServiceInfo::structSize);
+    static const size_t MinServiceWatcherEventSize = offsetof(DnssdServiceWatcherEvent, info) + MinServiceInfoSize;
+
+    static DnssdErrorType CreateServiceWatcher(const char* serviceName, DnssdServiceChangedCallback callback, DnssdServiceChangedContextCallback contextCallback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher);
+
     DNSSD_API DnssdErrorType dnssd_initialize()
     {
         DnssdErrorType result = DNSSD_NO_ERROR;
@@ -44,25 +54,58 @@ namespace dnssd_uwp
 
 
     DNSSD_API DnssdErrorType dnssd_create_service_watcher(const char* serviceName, DnssdServiceChangedCallback callback, DnssdServiceWatcherPtr *serviceWatcher)
+    {
+        return dnssd_create_service_watcher_with_options(serviceName, callback, nullptr, serviceWatcher);
+    }
+
+    DNSSD_API DnssdErrorType dnssd_create_service_watcher_with_options(const char* serviceName, DnssdServiceChangedCallback callback, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher)
+    {
+        return CreateServiceWatcher(serviceName, callback, nullptr, nullptr, options, serviceWatcher);
+    }
+
+    DNSSD_API DnssdErrorType dnssd_create_service_watcher_with_context(const char* serviceName, DnssdServiceChangedContextCallback callback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher)
+    {
+        return CreateServiceWatcher(serviceName, nullptr, callback, context, options, serviceWatcher);
+    }
+
+    static DnssdErrorType CreateServiceWatcher(const char* serviceName, DnssdServiceChangedCallback callback, DnssdServiceChangedContextCallback contextCallback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher)
     {
         DnssdErrorType result = DNSSD_NO_ERROR;
 
         *serviceWatcher = nullptr;
 
-        auto watcher = ref new DnssdServiceWatcher(serviceName, callback);
-        result = watcher->Initialize();
+        // a caller built with an older dnssd.h passes a shorter struct. The members it does not know keep their defaults
+        DnssdServiceWatcherOptions watcherOptions = {};
+        if (options != nullptr)
+        {
+            if (options->structSize < sizeof(options->structSize) || options->structSize > sizeof(DnssdServiceWatcherOptions))
+            {
+                return DNSSD_INVALID_PARAMETER_ERROR;
+            }
+            memcpy(&watcherOptions, options, options->structSize);
+        }
+        watcherOptions.structSize = sizeof(DnssdServiceWatcherOptions);
 
-        if (result != DNSSD_NO_ERROR)
+        auto watcher = ref new DnssdServiceWatcher(serviceName, watcherOptions, callback);
+        if (contextCallback != nullptr)
         {
-            *serviceWatcher = nullptr;
-            watcher = nullptr;
+            watcher->SetDnssdServiceChangedContextCallback(contextCallback, context);
         }
-        else
+
+        // callbacks receive the handle returned to the caller, so it exists before the first callback
+        auto wrapper = new DnssdServiceWatcherWrapper(watcher);
+        watcher->SetHandle((DnssdServiceWatcherPtr)wrapper);
+        result = watcher->Initialize();
+
+        if (result != DNSSD_NO_ERROR)
         {
-            auto wrapper = new DnssdServiceWatcherWrapper(watcher);
-            *serviceWatcher = (DnssdServiceWatcherPtr)wrapper;
+            // release the timers, DeviceWatcher handlers and executor a failed Initialize may have started
+            watcher->Stop();
+            delete wrapper;
+            return result;
         }
 
+        *serviceWatcher = (DnssdServiceWatcherPtr)wrapper;
         return result;
     }
 
@@ -71,17 +114,84 @@ namespace dnssd_uwp
         if (serviceWatcher)
         {
             DnssdServiceWatcherWrapper* watcher = (DnssdServiceWatcherWrapper*)serviceWatcher;
+
+            // stop the DeviceWatcher and save the warm-start cache before the wrapper goes away
+            watcher->GetWatcher()->Stop();
             delete watcher;
         }
     }
 
+    DNSSD_API DnssdErrorType dnssd_get_service_watcher_event_handle(DnssdServiceWatcherPtr serviceWatcher, void** eventHandle)
+    {
+        if (serviceWatcher == nullptr || eventHandle == nullptr)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        DnssdServiceWatcherWrapper* watcher = (DnssdServiceWatcherWrapper*)serviceWatcher;
+        *eventHandle = watcher->GetWatcher()->GetEventHandle();
+        return *eventHandle != nullptr ? DNSSD_NO_ERROR : DNSSD_INVALID_PARAMETER_ERROR;
+    }
+
+    DNSSD_API DnssdErrorType dnssd_poll_service_watcher(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int* count)
+    {
+        // every event must at least hold the update, the service's id, name, host and port, and structSize
+        if (serviceWatcher == nullptr || count == nullptr || (events == nullptr && maxEvents > 0) || eventSize < MinServiceWatcherEventSize)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        DnssdServiceWatcherWrapper* watcher = (DnssdServiceWatcherWrapper*)serviceWatcher;
+        return watcher->GetWatcher()->Poll(events, eventSize, maxEvents, *count);
+    }
+
+    DNSSD_API DnssdErrorType dnssd_pick_instance(DnssdServiceWatcherPtr serviceWatcher, DnssdPickPolicy policy, DnssdServiceInfo* info)
+    {
+        if (serviceWatcher == nullptr || info == nullptr || info->structSize < MinServiceInfoSize)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        // info may come from an older or newer dnssd.h
+        DnssdServiceInfo picked;
+        DnssdServiceWatcherWrapper* wrapper = (DnssdServiceWatcherWrapper*)serviceWatcher;
+        DnssdErrorType result = wrapper->GetWatcher()->PickInstance(policy, picked);
+        if (result == DNSSD_NO_ERROR)
+        {
+            CopyDnssdServiceInfo(picked, info, info->structSize);
+        }
+        return result;
+    }
+
+    DNSSD_API DnssdErrorType dnssd_get_service_watcher_stats(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherStats* stats)
+    {
+        if (serviceWatcher == nullptr || stats == nullptr)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        DnssdServiceWatcherWrapper* wrapper = (DnssdServiceWatcherWrapper*)serviceWatcher;
+        wrapper->GetWatcher()->GetStats(*stats);
+        return DNSSD_NO_ERROR;
+    }
+
     DNSSD_API DnssdErrorType dnssd_create_service(const char* serviceName, const char* port, DnssdServicePtr *service)
+    {
+        return dnssd_create_named_service("dnssd", serviceName, port, service);
+    }
+
+    DNSSD_API DnssdErrorType dnssd_create_named_service(const char* instanceName, const char* serviceName, const char* port, DnssdServicePtr *service)
     {
         DnssdErrorType result = DNSSD_NO_ERROR;
 
         *service = nullptr;
 
-        auto s = ref new DnssdService(serviceName, port);
+        if (instanceName == nullptr || *instanceName == '\0')
+        {
+            return DNSSD_INVALID_SERVICE_NAME_ERROR;
+        }
+
+        auto s = ref new DnssdService(instanceName, serviceName, port);
         result = s->Start();
 
         if (result != DNSSD_NO_ERROR)
@@ -98,6 +208,17 @@ namespace dnssd_uwp
         return result;
     }
 
+    DNSSD_API DnssdErrorType dnssd_update_service(DnssdServicePtr service, const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port)
+    {
+        if (service == nullptr || (attributes == nullptr && attributeCount > 0))
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        DnssdServiceWrapper* wrapper = (DnssdServiceWrapper*)service;
+        return wrapper->GetService()->Update(attributes, attributeCount, port);
+    }
+
     DNSSD_API void dnssd_free_service(DnssdServicePtr service)
     {
         if (service)
@@ -106,5 +227,49 @@ namespace dnssd_uwp
             delete wrapper;
         }
     }
+
+    DNSSD_API DnssdErrorType dnssd_create_reflector(const DnssdReflectorOptions* options, DnssdReflectorPtr* reflector)
+    {
+        if (options == nullptr || reflector == nullptr)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        *reflector = nullptr;
+
+        auto r = new DnssdReflector();
+        DnssdErrorType result = r->Initialize(*options);
+        if (result != DNSSD_NO_ERROR)
+        {
+            delete r;
+            return result;
+        }
+
+        *reflector = (DnssdReflectorPtr)r;
+        return DNSSD_NO_ERROR;
+    }
+
+    DNSSD_API DnssdErrorType dnssd_get_reflector_stats(DnssdReflectorPtr reflector, DnssdReflectorStats* stats)
+    {
+        if (reflector == nullptr || stats == nullptr)
+        {
+            return DNSSD_INVALID_PARAMETER_ERROR;
+        }
+
+        ((DnssdReflector*)reflector)->GetStats(*stats);
+        return DNSSD_NO_ERROR;
+    }
+
+    DNSSD_API void dnssd_free_reflector(DnssdReflectorPtr reflector)
+    {
+        if (reflector)
+        {
+            DnssdReflector* r = (DnssdReflector*)reflector;
+
+            // withdraw the proxies before the reflector goes away
+            r->Stop();
+            delete r;
+        }
+    }
 }
 
@@ -36,19 +36,33 @@ namespace dnssd_uwp
         DNSSD_INVALID_PARAMETER_ERROR,
         DNSSD_MEMORY_ERROR,
         DNSSD_DLL_MISSING_ERROR,                    // dnssd dll not found
-        DNSSD_UNSPECIFIED_ERROR
+        DNSSD_UNSPECIFIED_ERROR,
+        DNSSD_NO_INSTANCE_ERROR                     // the service watcher has no live instance to pick
     };
 
     typedef void* DnssdServiceWatcherPtr;
     typedef void* DnssdServicePtr;
 
-    // dnssd service info
+    // dnssd service info flags
+    enum DnssdServiceFlags {
+        DNSSD_SERVICE_FLAG_PROVISIONAL = 0x1,       // restored from the warm-start cache and not yet confirmed by the network
+        DNSSD_SERVICE_FLAG_UNHEALTHY = 0x2          // liveness probes of host:port failed. Cleared by the next successful probe
+    };
+
+    // dnssd service info. id, instanceName, host and port keep their original offsets. Later members are only ever appended
+    // after structSize, which tells how many a struct holds
     typedef struct 
     {
         const char* id;
         const char* instanceName;
         const char* host;
         const char* port;
+        unsigned int structSize;                    // sizeof(DnssdServiceInfo) as built. Set by the library on reported services, by the caller for dnssd_pick_instance()
+        unsigned int flags;                         // DnssdServiceFlags
+        unsigned int changedFields;                 // ServiceUpdated only: DnssdServiceFields that differ from the last report of this service
+        const char* previousInstanceName;           // value before the change if changedFields has the field and the watcher reports previous values.
+        const char* previousHost;                   // nullptr otherwise
+        const char* previousPort;
     } DnssdServiceInfo;
 
     typedef DnssdServiceInfo* DnssdServiceInfoPtr;
@@ -62,10 +76,119 @@ namespace dnssd_uwp
     // dnssd service watcher changed callback
     typedef void(*DnssdServiceChangedCallback) (const DnssdServiceWatcherPtr portWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info);
 
+    // dnssd service watcher changed callback with the context passed to dnssd_create_service_watcher_with_context
+    typedef void(*DnssdServiceChangedContextCallback) (const DnssdServiceWatcherPtr serviceWatcher, DnssdServiceUpdateType update, DnssdServiceInfoPtr info, void* context);
+
+    // thread dnssd service watcher callbacks are delivered on
+    enum DnssdCallbackExecutor {
+        DNSSD_EXECUTOR_INLINE = 0,                  // on the Windows DNS-SD event thread, one callback at a time per watcher
+        DNSSD_EXECUTOR_THREAD,                      // on a thread owned by the watcher, in order
+        DNSSD_EXECUTOR_POOL,                        // on the thread pool. In order for each service id, in parallel across services
+        DNSSD_EXECUTOR_QUEUE                        // no callbacks. Events are queued for dnssd_poll_service_watcher()
+    };
+
+    // dnssd service watcher fields. Fields left out of DnssdServiceWatcherOptions::fieldMask are not requested from Windows,
+    // not tracked and not compared for changes, and are reported as empty strings
+    enum DnssdServiceFields {
+        DNSSD_FIELD_ID = 0x1,                       // always reported. A mask of DNSSD_FIELD_ID alone only reports instances coming and going
+        DNSSD_FIELD_INSTANCE_NAME = 0x2,
+        DNSSD_FIELD_HOST = 0x4,
+        DNSSD_FIELD_PORT = 0x8,                     // includes the SRV priority and weight used by dnssd_pick_instance()
+        DNSSD_FIELD_ALL = 0xf
+    };
+
+    // Service type passed to the dnssd service watcher create functions to browse the service types on the network instead of
+    // service instances. Each reported service is a type: id and instanceName are the type (e.g. "_daap._tcp"), host and port are empty.
+    // A type is removed once a full scan finds no instance of it. Only the instance name filter applies; a host or TXT key filter is
+    // rejected with DNSSD_INVALID_PARAMETER_ERROR. Every instance on the link is browsed to find the types
+    #define DNSSD_SERVICE_TYPE_ENUMERATION "_services._dns-sd._udp"
+
     // dnssd service watcher create function
     typedef  DnssdErrorType(__cdecl *DnssdCreateServiceWatcherFunc)(const char* serviceName, DnssdServiceChangedCallback callback, DnssdServiceWatcherPtr *serviceWatcher);
     DNSSD_API DnssdErrorType __cdecl dnssd_create_service_watcher(const char* serviceName, DnssdServiceChangedCallback callback, DnssdServiceWatcherPtr * serviceWatcher);
 
+    // dnssd service watcher options. Members are only ever appended. Zero the struct and set structSize before use
+    typedef struct
+    {
+        unsigned int structSize;                    // sizeof(DnssdServiceWatcherOptions). Members past structSize keep their defaults; a size larger than the library's is rejected
+        unsigned int debounceMilliseconds;          // merge changes to the same service id inside this window into one ServiceUpdated callback. 0 reports every change at once
+        const char* instanceNameFilter;             // only report instances whose name matches this glob ('*' and '?'). nullptr reports all instances
+        const char* hostFilter;                     // only report instances on this host name, address or subnet ("192.168.1.0/24"). nullptr reports all hosts
+        const char* txtKeyFilter;                   // only report instances whose TXT record contains this key. nullptr reports all instances
+        const char* cachePath;                      // UTF-8 path of the warm-start cache file. nullptr disables the cache
+        unsigned int cacheTtlSeconds;               // how long after shutdown a saved service may be restored. 0 uses 120 seconds
+        DnssdCallbackExecutor executor;             // where callbacks run. Queued callbacks are dropped when the watcher is freed
+        const char* domain;                         // browse this unicast DNS domain (wide-area DNS-SD). nullptr or "local" browses the link with mDNS
+        const char* unicastServer;                  // IPv4 address of the DNS server for domain. nullptr uses the system resolvers
+        unsigned int pollSeconds;                   // unicast browse interval. 0 derives it from the domain's SOA record
+        unsigned int shardCount;                    // split the service table into this many shards updated in parallel (at most 64). 0 or 1 updates it on the backend thread
+        unsigned int probeIntervalSeconds;          // check every instance's host and port with a TCP connect this often. 0 disables liveness probing
+        unsigned int probeTimeoutMilliseconds;      // a probe fails if the connect takes longer. 0 uses 2000
+        unsigned int probesPerSecond;               // probes started per second for the whole watcher. 0 uses 20
+        unsigned int fieldMask;                     // DnssdServiceFields to request and report. 0 reports every field. Probing adds host and port
+        unsigned int reportPreviousValues;          // nonzero to report the previous value of each changed field with ServiceUpdated
+    } DnssdServiceWatcherOptions;
+
+    // dnssd service watcher create function with options. options may be nullptr
+    typedef  DnssdErrorType(__cdecl *DnssdCreateServiceWatcherWithOptionsFunc)(const char* serviceName, DnssdServiceChangedCallback callback, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher);
+    DNSSD_API DnssdErrorType __cdecl dnssd_create_service_watcher_with_options(const char* serviceName, DnssdServiceChangedCallback callback, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr * serviceWatcher);
+
+    // dnssd service watcher create function with a callback context. options may be nullptr
+    typedef  DnssdErrorType(__cdecl *DnssdCreateServiceWatcherWithContextFunc)(const char* serviceName, DnssdServiceChangedContextCallback callback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr *serviceWatcher);
+    DNSSD_API DnssdErrorType __cdecl dnssd_create_service_watcher_with_context(const char* serviceName, DnssdServiceChangedContextCallback callback, void* context, const DnssdServiceWatcherOptions* options, DnssdServiceWatcherPtr * serviceWatcher);
+
+    // dnssd service watcher statistics
+    typedef struct
+    {
+        unsigned int firstResultMilliseconds;       // time from watcher start to the first reported service. 0 until a service has been reported
+        unsigned int enumerationMilliseconds;       // time from watcher start to the end of the first enumeration pass. 0 until the pass completes
+        unsigned int backendEvents;                 // added, updated and removed events received from the Windows DNS-SD DeviceWatcher
+        unsigned int filteredEvents;                // backend events rejected by the watcher filters
+        unsigned int mergedEvents;                  // changes merged into an already open debounce window
+        unsigned int callbacks;                     // callbacks delivered to the client
+        unsigned int instanceSlots;                 // service records allocated by the watcher's service table. Stays flat under steady churn
+        unsigned int cachedServices;                // provisional services restored from the warm-start cache
+        unsigned int removals;                      // ServiceRemoved callbacks delivered
+        unsigned int lastRemovalMilliseconds;       // time from a service's departure to its ServiceRemoved callback, for the latest removal
+        unsigned int maxRemovalMilliseconds;        // largest lastRemovalMilliseconds seen
+        unsigned int probes;                        // liveness probes started
+        unsigned int failedProbes;                  // liveness probes that could not connect in time
+        unsigned int services;                      // services in the watcher's table
+        unsigned int tableBytes;                    // approximate heap use of the service table, pooled strings included
+    } DnssdServiceWatcherStats;
+
+    typedef DnssdErrorType(__cdecl *DnssdGetServiceWatcherStatsFunc)(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherStats* stats);
+    DNSSD_API DnssdErrorType __cdecl dnssd_get_service_watcher_stats(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherStats* stats);
+
+    // dnssd service watcher event returned by dnssd_poll_service_watcher()
+    typedef struct
+    {
+        DnssdServiceUpdateType update;
+        DnssdServiceInfo info;                      // strings are valid until the next poll of the same watcher
+    } DnssdServiceWatcherEvent;
+
+    // Win32 manual reset event that is signaled while a DNSSD_EXECUTOR_QUEUE watcher has events to poll. Owned by the watcher
+    typedef DnssdErrorType(__cdecl *DnssdGetServiceWatcherEventHandleFunc)(DnssdServiceWatcherPtr serviceWatcher, void** eventHandle);
+    DNSSD_API DnssdErrorType __cdecl dnssd_get_service_watcher_event_handle(DnssdServiceWatcherPtr serviceWatcher, void** eventHandle);
+
+    // move up to maxEvents queued events of a DNSSD_EXECUTOR_QUEUE watcher into events. count receives the number of events returned.
+    // eventSize is sizeof(DnssdServiceWatcherEvent) as the caller built it and is the stride of events. Each info.structSize gives the
+    // members actually written
+    typedef DnssdErrorType(__cdecl *DnssdPollServiceWatcherFunc)(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int* count);
+    DNSSD_API DnssdErrorType __cdecl dnssd_poll_service_watcher(DnssdServiceWatcherPtr serviceWatcher, DnssdServiceWatcherEvent* events, unsigned int eventSize, unsigned int maxEvents, unsigned int* count);
+
+    // dnssd_pick_instance() policies
+    enum DnssdPickPolicy {
+        DNSSD_PICK_SRV_WEIGHT = 0,                  // lowest SRV priority, then a random choice weighted by SRV weight (RFC 2782)
+        DNSSD_PICK_ROUND_ROBIN,                     // every live instance in turn
+        DNSSD_PICK_LEAST_RECENTLY_PICKED            // the instance picked longest ago by any policy. Instances never picked come first
+    };
+
+    // choose one of the live instances of a service watcher. Provisional services are never picked and type enumeration watchers have no instances.
+    // The strings of info are valid until the next pick of the same watcher. Set info->structSize to sizeof(DnssdServiceInfo) before the call
+    typedef DnssdErrorType(__cdecl *DnssdPickInstanceFunc)(DnssdServiceWatcherPtr serviceWatcher, DnssdPickPolicy policy, DnssdServiceInfo* info);
+    DNSSD_API DnssdErrorType __cdecl dnssd_pick_instance(DnssdServiceWatcherPtr serviceWatcher, DnssdPickPolicy policy, DnssdServiceInfo* info);
+
     typedef void(__cdecl *DnssdFreeServiceWatcherFunc)(DnssdServiceWatcherPtr serviceWatcher);
     DNSSD_API void __cdecl dnssd_free_service_watcher(DnssdServiceWatcherPtr serviceWatcher);
 
@@ -73,9 +196,62 @@ namespace dnssd_uwp
     typedef  DnssdErrorType(__cdecl *DnssdCreateServiceFunc)(const char* serviceName, const char* port, DnssdServicePtr *service);
     DNSSD_API DnssdErrorType __cdecl dnssd_create_service(const char* serviceName, const char* port, DnssdServicePtr *service);
 
+    // dnssd named service create function. Registers instanceName (UTF-8) instead of the default "dnssd" instance name
+    typedef  DnssdErrorType(__cdecl *DnssdCreateNamedServiceFunc)(const char* instanceName, const char* serviceName, const char* port, DnssdServicePtr *service);
+    DNSSD_API DnssdErrorType __cdecl dnssd_create_named_service(const char* instanceName, const char* serviceName, const char* port, DnssdServicePtr *service);
+
+    // dnssd service TXT record attribute. The Windows responder has no boolean attributes, so a nullptr value is
+    // announced as an empty value ("key=")
+    typedef struct
+    {
+        const char* key;
+        const char* value;
+    } DnssdTxtAttribute;
+
+    // dnssd service update function. Replaces the TXT attributes of a registered service and, if port is not nullptr, its port.
+    // The instance is re-announced under the same name, so watchers see ServiceUpdated instead of a remove and add
+    typedef  DnssdErrorType(__cdecl *DnssdUpdateServiceFunc)(DnssdServicePtr service, const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port);
+    DNSSD_API DnssdErrorType __cdecl dnssd_update_service(DnssdServicePtr service, const DnssdTxtAttribute* attributes, unsigned int attributeCount, const char* port);
+
     typedef void(__cdecl *DnssdFreeServiceFunc)(DnssdServicePtr service);
     DNSSD_API void __cdecl dnssd_free_service(DnssdServicePtr service);
 
+    // dnssd reflector functions
+
+    typedef void* DnssdReflectorPtr;
+
+    // dnssd reflector options. One reflector carries one direction between two network segments; create one per direction
+    typedef struct
+    {
+        const char* const* serviceTypes;            // allow list of the service types to reflect (e.g. "_ipp._tcp"). Other types are never forwarded
+        unsigned int serviceTypeCount;
+        const char* sourceSubnet;                   // reflect the instances with an address in this subnet ("192.168.1.0/24"). Required: it keeps the target's own instances out
+        const char* targetAddress;                  // local address of the adapter the proxies are announced on. nullptr announces them on every adapter
+    } DnssdReflectorOptions;
+
+    // dnssd reflector statistics
+    typedef struct
+    {
+        unsigned int proxies;                       // instances currently announced on the target
+        unsigned int forwardedChanges;              // registrations, re-announcements and removals made on the target
+        unsigned int suppressedChanges;             // source events that changed nothing on the target and were not forwarded
+        unsigned int failedChanges;                 // forwarded changes the Windows DNS-SD responder rejected
+    } DnssdReflectorStats;
+
+    // Reflect the allow-listed service types seen on the source segment onto the target segment. Every source instance is announced
+    // on the target by a proxy registration with the instance's address and port, so queries on the target are answered by the Windows
+    // responder from the proxies instead of being forwarded. Only added, moved and removed instances cause traffic on the target.
+    // Experimental: a proxy has no TXT record, and the Windows responder may not publish the address of another host. Verify the
+    // proxies from the target segment before relying on them
+    typedef DnssdErrorType(__cdecl *DnssdCreateReflectorFunc)(const DnssdReflectorOptions* options, DnssdReflectorPtr* reflector);
+    DNSSD_API DnssdErrorType __cdecl dnssd_create_reflector(const DnssdReflectorOptions* options, DnssdReflectorPtr* reflector);
+
+    typedef DnssdErrorType(__cdecl *DnssdGetReflectorStatsFunc)(DnssdReflectorPtr reflector, DnssdReflectorStats* stats);
+    DNSSD_API DnssdErrorType __cdecl dnssd_get_reflector_stats(DnssdReflectorPtr reflector, DnssdReflectorStats* stats);
+
+    // stop reflecting and withdraw every proxy from the target
+    typedef void(__cdecl *DnssdFreeReflectorFunc)(DnssdReflectorPtr reflector);
+    DNSSD_API void __cdecl dnssd_free_reflector(DnssdReflectorPtr reflector);
 
 };
  
\ No newline at end of file